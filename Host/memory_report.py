@@ -0,0 +1,76 @@
+#!/usr/bin/env python3
+"""
+Flash and SRAM used by each module of a build, from the object files left in the build directory.
+
+Flash holds .text, .progmem and the initial values of .data, SRAM holds .data and .bss (the stack
+is not counted). String literals not moved to PROGMEM end up in .data, so they show in both.
+
+    arduino-cli compile --build-path build Main
+    python3 memory_report.py build
+    python3 memory_report.py build --size /path/to/avr-size
+"""
+
+import argparse
+import os
+import re
+import subprocess
+import sys
+
+FLASH_SIZE = 32768
+SRAM_SIZE = 2048
+
+FLASH_SECTIONS = re.compile(r"^\.(text|progmem|data)")
+SRAM_SECTIONS = re.compile(r"^\.(data|bss|noinit)")
+
+
+def sections(size_tool, path):
+    """Section name -> size in bytes, as reported by "avr-size -A"."""
+    output = subprocess.run([size_tool, "-A", path], check=True, capture_output=True, text=True).stdout
+    result = {}
+    for line in output.splitlines():
+        fields = line.split()
+        if len(fields) >= 2 and fields[0].startswith(".") and fields[1].isdigit():
+            result[fields[0]] = result.get(fields[0], 0) + int(fields[1])
+    return result
+
+
+def objects(build_path, all_objects):
+    """Object files of the sketch and its libraries, the core is left out unless asked for."""
+    for root, _, files in os.walk(build_path):
+        if not all_objects and os.sep + "core" in root[len(build_path):]:
+            continue
+        for name in sorted(files):
+            if name.endswith(".o"):
+                yield os.path.join(root, name)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("build_path", help="build directory (arduino-cli --build-path)")
+    parser.add_argument("--size", default="avr-size", help="avr-size executable")
+    parser.add_argument("--core", action="store_true", help="include the Arduino core objects")
+    args = parser.parse_args()
+
+    rows = []
+    for path in objects(args.build_path, args.core):
+        found = sections(args.size, path)
+        flash = sum(v for k, v in found.items() if FLASH_SECTIONS.match(k))
+        sram = sum(v for k, v in found.items() if SRAM_SECTIONS.match(k))
+        rows.append((os.path.basename(path).split(".")[0], flash, sram))
+
+    if not rows:
+        sys.exit("no object files found in %s" % args.build_path)
+
+    rows.sort(key=lambda row: row[2], reverse=True)
+    print("%-20s %8s %8s" % ("Module", "Flash", "SRAM"))
+    for name, flash, sram in rows:
+        print("%-20s %8d %8d" % (name, flash, sram))
+
+    flash = sum(row[1] for row in rows)
+    sram = sum(row[2] for row in rows)
+    print("%-20s %8d %8d" % ("Total", flash, sram))
+    print("%-20s %7.1f%% %7.1f%%" % ("Of the device", 100.0 * flash / FLASH_SIZE, 100.0 * sram / SRAM_SIZE))
+
+
+if __name__ == "__main__":
+    main()
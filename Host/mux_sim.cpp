@@ -0,0 +1,177 @@
+/*
+ * Host simulation of the socket sequencer (MultiTester Lib/mux.cpp), against a simulated socket bank.
+ *
+ * The Mux hooks are pointed at the bank: selecting a socket routes the probes to it, measuring returns the part
+ * sitting there, and the clock only moves when the sequencer measures, switches or looks at it (1 ms a look).
+ * Capacitors are charged by their measurement and only bleed while their socket is deselected, as on the board.
+ * Checks:
+ *
+ *  - every socket is reported "rounds" times, carrying its own socket number and part
+ *  - no part is measured while it still holds charge from its previous measurement
+ *  - a socket waiting on its discharge never holds up one that is ready (interleaving)
+ *  - the sweep beats measuring the sockets in turn, waiting on each discharge
+ *
+ *    g++ -std=gnu++11 -I Host/sim -I "MultiTester Lib" Host/mux_sim.cpp "MultiTester Lib/mux.cpp" -o mux_sim
+ *    ./mux_sim
+ */
+
+#include <common.h>
+#include <config.h>
+#include <functions.h>
+
+#include <stdio.h>
+
+#define SIM_MEASURE_MS 200 // Identification time of a part
+
+struct Sim_Part
+{
+    byte Flag;
+    float C_uF;                 // Capacitors only
+    unsigned long Left;         // Bleeding time still needed to be discharged (ms)
+};
+
+static Sim_Part Bank[MUX_SOCKETS];
+static byte Sockets = 0;
+static byte Selected = 0;
+static unsigned long Clock = 0;
+static unsigned long Settled = 0;   // Clock of the last bleed update
+
+static unsigned int Violations = 0; // Charged parts measured
+static unsigned int Stalls = 0;     // Sockets waited on while another one was ready
+static byte Order[MUX_SOCKETS * 8];
+static unsigned int Reports = 0;
+
+// Bleeds the deselected sockets up to the present.
+static void settle()
+{
+    unsigned long elapsed = Clock - Settled;
+    for(byte s = 0; s < Sockets; s++)
+    {
+        if(s + 1 == Selected){ continue; }
+        Bank[s].Left = (Bank[s].Left > elapsed) ? Bank[s].Left - elapsed : 0;
+    }
+    Settled = Clock;
+}
+
+static void sim_select(byte socket)
+{
+    settle();
+    Selected = socket;
+    Clock += MUX_SWITCH_MS;
+}
+
+/*
+ * Readiness of the sockets still to be measured when the sequencer decides on the next one (its first look at the
+ * clock after a report). Measuring a socket that was not ready then, while another one was, is a stall.
+ */
+static byte Pending[MUX_SOCKETS];
+static bool Deciding = 1;
+static bool Ready_At_Decision[MUX_SOCKETS];
+
+static unsigned long sim_now()
+{
+    settle();
+    if(Deciding)
+    {
+        for(byte s = 0; s < Sockets; s++){ Ready_At_Decision[s] = Pending[s] && !Bank[s].Left; }
+        Deciding = 0;
+    }
+    return Clock++;
+}
+
+static void check_stall(byte socket)
+{
+    if(Ready_At_Decision[socket - 1]){ return; }
+    for(byte s = 0; s < Sockets; s++)
+    {
+        if(Ready_At_Decision[s]){ Stalls ++; return; }
+    }
+}
+
+static byte sim_measure(Result &DUT)
+{
+    settle();
+    Sim_Part &part = Bank[Selected - 1];
+    if(part.Left){ Violations ++; }
+    check_stall(Selected);
+
+    Clock += SIM_MEASURE_MS;
+    settle();
+
+    DUT.clear();
+    DUT.Flag = part.Flag;
+    if(part.Flag == CAPACITOR_FLAG)
+    {
+        DUT.Value[V_CAPACITANCE] = part.C_uF;
+        DUT.Power = 'u';
+        part.Left = 5 * part.C_uF * 1e-6 * (2.0 * MUX_BLEED_R) * 1000; // Charged by the measure
+    }
+    else { DUT.Value[V_RESISTANCE] = 1000; }
+    return DUT.Flag;
+}
+
+static void sim_report(byte request, const Result &DUT)
+{
+    if(DUT.Socket != Selected || DUT.Flag != Bank[DUT.Socket - 1].Flag){ Violations ++; }
+    if(Reports < sizeof(Order)){ Order[Reports] = DUT.Socket; }
+    Reports ++;
+    Pending[DUT.Socket - 1] --;
+    Deciding = 1;
+}
+
+// Library functions mux.cpp links against, outside the simulation.
+byte identify(Result &DUT, bool Use_Rh){ DUT.clear(); return 0; }
+float Capacitance_F(const Result &DUT){ return DUT.Value[V_CAPACITANCE] * (DUT.Power == 'u' ? 1e-6 : 1); }
+void pinMode(uint8_t pin, uint8_t mode){}
+void digitalWrite(uint8_t pin, uint8_t value){}
+void delay(unsigned long ms){ Clock += ms; }
+unsigned long millis(){ return Clock; }
+
+static bool run(const char *name, const Sim_Part *parts, byte sockets, byte rounds)
+{
+    Sockets = sockets;
+    Selected = 0;
+    Clock = Settled = 0;
+    Violations = Stalls = Reports = 0;
+    Deciding = 1;
+
+    unsigned long serial = 0; // Measuring in turn, waiting on each discharge
+    for(byte s = 0; s < sockets; s++)
+    {
+        Bank[s] = parts[s];
+        Pending[s] = rounds;
+        serial += rounds * (SIM_MEASURE_MS + (unsigned long)(5 * parts[s].C_uF * 1e-6 * 2.0 * MUX_BLEED_R * 1000));
+    }
+
+    unsigned int done = Mux_Sweep(0, sockets, rounds, sim_report);
+
+    bool counts = (done == sockets * rounds && Reports == done);
+    for(byte s = 0; s < sockets; s++){ counts &= !Pending[s]; }
+    bool ok = counts && !Violations && !Stalls && Clock < serial && !Selected;
+
+    printf("%-26s %s  %u reports, %lu ms (in turn %lu ms), order", name, ok ? "PASS" : "FAIL", done, Clock, serial);
+    for(unsigned int i = 0; i < Reports && i < sizeof(Order); i++){ printf(" %d", Order[i]); }
+    printf("\n");
+    if(!counts){ printf("    wrong report counts\n"); }
+    if(Violations){ printf("    %u charged or misreported parts\n", Violations); }
+    if(Stalls){ printf("    %u waits on a socket while another one was ready\n", Stalls); }
+    if(Selected){ printf("    socket %d left selected\n", Selected); }
+    return ok;
+}
+
+int main()
+{
+    Mux.select = sim_select;
+    Mux.measure = sim_measure;
+    Mux.now = sim_now;
+
+    const Sim_Part Mixed[] = { {CAPACITOR_FLAG, 10, 0}, {RESISTOR_FLAG, 0, 0}, {RESISTOR_FLAG, 0, 0}, {CAPACITOR_FLAG, 1, 0} };
+    const Sim_Part Caps[] = { {CAPACITOR_FLAG, 47, 0}, {CAPACITOR_FLAG, 4.7, 0}, {CAPACITOR_FLAG, 22, 0} };
+    const Sim_Part Single[] = { {CAPACITOR_FLAG, 10, 0} };
+
+    bool ok = run("mixed bank, 3 rounds", Mixed, 4, 3);
+    ok &= run("capacitors only, 4 rounds", Caps, 3, 4);
+    ok &= run("one socket, 3 rounds", Single, 1, 3);
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,165 @@
+#!/usr/bin/env python3
+"""
+Host side decoder for the binary result frames sent by the tester in BINARY_MODE.
+
+Frames are COBS encoded and terminated by a 0x00 byte, see "MultiTester Lib/protocol.cpp" for the layout.
+Reads from a serial port (needs pyserial) or from a raw capture file, and prints one line per result.
+
+    python3 result_decoder.py /dev/ttyUSB0
+    python3 result_decoder.py capture.bin --file
+"""
+
+import argparse
+import struct
+import sys
+
+RESULT_VERSION = 8
+LINK_BAUD = 500000
+
+FLAGS = {
+    2: "BJT", 3: "MOS", 4: "NPN", 5: "PNP",
+    6: "NMOS_ENH", 7: "NMOS_DEP", 8: "PMOS_ENH", 9: "PMOS_DEP",
+    15: "SHORT", 16: "DIODE", 17: "DIODE",
+    32: "CAPACITOR", 64: "INDUCTOR", 128: "RESISTOR", 129: "RNET", 240: "OPEN",
+    251: "CURVE", 252: "LINK", 253: "ERROR", 254: "CAL", 255: "OK",
+}
+
+KINDS = {1: "silicon", 2: "Schottky", 3: "LED", 4: "Zener", 5: "potentiometer",
+         6: "gain", 7: "active", 8: "saturated"}
+
+PARTIAL = {1: "fewer samples", 2: "values dropped", 3: "timeout"}
+
+PROFILES = {1: "fast", 2: "balanced", 3: "precise", 4: "custom"}
+
+# Names of the values carried by each kind of device, in frame order
+VALUES = {
+    "RESISTOR": ("R",),
+    "RNET": ("R_a", "R_wiper", "R_b", "wiper_percent"),
+    "CAPACITOR": ("C", "leakage_uA", "DA_percent", "R_parallel_k"),
+    "INDUCTOR": ("L_uH", "R_parasit", "Q"),
+    "DIODE": ("VdH_mV", "VdL_mV", "IH", "IL_uA", "n", "Is_A", "Rs", "Vz_mV"),
+    "SEMI": ("V1_mV", "V2_mV", "Ib_uA", "Beta"),
+    "MOS": ("Vgs_th_mV", "Rds_on_Ohm", "Ciss_pF", "Qg_nC"),
+    "ERROR": ("code",),
+    "CAL": ("Rl", "Rm_k", "Rh_k"),
+    "LINK": ("both_ways",),
+    "CURVE": ("Ib_uA", "Vce_mV", "Ic_mA", "Vbe_mV", "hFE"),
+}
+
+
+def cobs_decode(data):
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data):
+            raise ValueError("bad COBS block")
+        out += data[i + 1:i + code]
+        i += code
+        if code < 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def crc16(data):
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+
+def decode_frame(encoded):
+    frame = cobs_decode(encoded)
+    if len(frame) < 22:
+        raise ValueError("short frame")
+    body, (crc,) = frame[:-2], struct.unpack("<H", frame[-2:])
+    if crc16(body) != crc:
+        raise ValueError("CRC mismatch")
+
+    version, seq, request, flag, power, pin_a, pin_b, pin_c, elapsed, count, uncertainty, socket, subtype, partial, \
+        agree, profile = struct.unpack("<BBBBBBBBHBfBBBBB", body[:20])
+    if version != RESULT_VERSION:
+        raise ValueError("unknown protocol version %d" % version)
+    values = struct.unpack("<%df" % count, body[20:20 + 4 * count])
+
+    kind = FLAGS.get(flag, "UNKNOWN")
+    names = VALUES.get(kind) or (VALUES["SEMI"] if flag in (4, 5) else VALUES["MOS"] if 6 <= flag <= 9 else ())
+    if kind == "CAL" and pin_b:
+        names = ("stray_pF",)  # Stray capacitance of a pair of probes
+    elif kind == "CAL" and not pin_a:
+        names = ("Ri_low", "Ri_high", "die_C")  # Internal resistances, at the die temperature
+    return {
+        "seq": seq,
+        "request": request,
+        "device": kind,
+        "flag": flag,
+        "prefix": chr(power).strip(),
+        "pins": (pin_a, pin_b, pin_c),
+        "elapsed_ms": elapsed,
+        "uncertainty": uncertainty,
+        "socket": socket,
+        "kind": KINDS.get(subtype, ""),
+        "partial": PARTIAL.get(partial, ""),
+        "agree": agree,
+        "profile": PROFILES.get(profile, ""),
+        "values": dict(zip(names, values)),
+    }
+
+
+def frames(stream, follow):
+    buffer = bytearray()
+    while True:
+        chunk = stream.read(256)
+        if not chunk:
+            if follow:
+                continue  # Serial read timeout, the tester is idle
+            return
+        for byte in chunk:
+            if byte == 0:
+                if buffer:
+                    yield bytes(buffer)
+                buffer.clear()
+            else:
+                buffer.append(byte)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("source", help="serial port, or capture file with --file")
+    parser.add_argument("--file", action="store_true", help="read a raw capture instead of a serial port")
+    parser.add_argument("--baud", type=int, default=LINK_BAUD)
+    args = parser.parse_args()
+
+    if args.file:
+        stream = open(args.source, "rb")
+    else:
+        import serial  # pyserial
+        stream = serial.Serial(args.source, args.baud, timeout=1)
+
+    for encoded in frames(stream, not args.file):
+        try:
+            result = decode_frame(encoded)
+        except (ValueError, struct.error) as error:
+            print("# dropped frame: %s" % error, file=sys.stderr)
+            continue
+        values = " ".join("%s=%g%s" % (k, v, result["prefix"] if k in ("R", "C", "R_a", "R_wiper", "R_b") else "")
+                          for k, v in result["values"].items())
+        if result["uncertainty"]:
+            values += " +-%g" % result["uncertainty"]
+        if result["partial"]:
+            values += " (partial: %s)" % result["partial"]
+        if result["agree"]:
+            values += " (%d scans agree)" % result["agree"]
+        if result["profile"]:
+            values += " [%s]" % result["profile"]
+        socket = " S%d" % result["socket"] if result["socket"] else ""
+        device = (result["kind"] + " " if result["kind"] else "") + result["device"]
+        print("%3d #%-3d%s %-9s pins=%s %5d ms %s" % (result["seq"], result["request"], socket, device,
+                                                      result["pins"], result["elapsed_ms"], values), flush=True)
+
+
+if __name__ == "__main__":
+    main()
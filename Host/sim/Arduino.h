@@ -0,0 +1,45 @@
+/*
+ * Host stand-in for the Arduino core, just enough for the library headers and the modules the host
+ * simulations build (see Host/mux_sim.cpp). The pin and time functions are left to the simulation.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+
+typedef uint8_t byte;
+typedef bool _Bool; // A GNU C extension of avr-g++
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define DEC 10
+
+#define min(a,b) ((a)<(b)?(a):(b))
+#define max(a,b) ((a)>(b)?(a):(b))
+#define sq(x) ((x)*(x))
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+void delay(unsigned long ms);
+unsigned long millis();
+
+class __FlashStringHelper;
+
+class Print
+{
+  public:
+    virtual size_t write(uint8_t) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size){ size_t n = 0; while(size--){ n += write(*buffer++); } return n; }
+};
+
+class Stream : public Print
+{
+  public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+};
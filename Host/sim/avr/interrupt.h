@@ -0,0 +1 @@
+#pragma once // Host stand-in, see Arduino.h
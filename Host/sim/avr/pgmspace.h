@@ -0,0 +1,5 @@
+#pragma once // Host stand-in, see Arduino.h: flash is ordinary memory
+
+#define PROGMEM
+#define PGM_P const char *
+#define PSTR(s) (s)
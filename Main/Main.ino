@@ -6,119 +6,106 @@ const Probe P1 =
 {
   .ID = 15, //A1
   .Rl = 5, .Rm = 6, .Rh = 7,
-  .Rl_val = 663.4,
-  .Rm_val = 21.80,
-  .Rh_val = 677.5,
+  .Rl_cal = 663.4,
+  .Rm_cal = 21.80,
+  .Rh_cal = 677.5,
 };
 
 const Probe P2 = 
 {
   .ID = 16, //A2
   .Rl = 8, .Rm = 9, .Rh = 10,
-  .Rl_val = 662.3,
-  .Rm_val = 21.50,
-  .Rh_val = 677.7,
+  .Rl_cal = 662.3,
+  .Rm_cal = 21.50,
+  .Rh_cal = 677.7,
 };
 
 const Probe P3= 
 {
   .ID = 17, //A3
   .Rl = 11, .Rm = 12, .Rh = 13,
-  .Rl_val = 659.7,
-  .Rm_val = 21.67,
-  .Rh_val = 687.0,
+  .Rl_cal = 659.7,
+  .Rm_cal = 21.67,
+  .Rh_cal = 687.0,
 };
 
+const Probe *const Probes[PROBE_COUNT] = {&P1, &P2, &P3}; // Probe table, in board order
+
 const byte BRB_pin = 4;
 volatile bool buttonPressed = true; // A first measure is carried when booting.
 
 namespace attr
 {
-  Resistor_Specs    Resistor;
-  Capacitor_Specs   Capacitor;
-  Inductor_Specs    Inductor;
-  Diode_Specs       Diode;
-  Semic_Specs       Semiconductor;
+  byte              Output_Mode = DEFAULT_OUTPUT_MODE;
+  Measure_Profile   Profile;              // Selected in setup()
+  unsigned int      Budget = DEFAULT_BUDGET_MS;
+  byte              Consensus = DEFAULT_CONSENSUS;
+  Thermal_State     Thermal = {TEMP_CAL_C, 1, 1, 1};
   //extern bool Use_Rh;
 }
 
 void setup()
 {
-  Serial.begin(9600);
-  while(!Serial){};
+  Link.begin(LINK_BAUD);
 
   pinMode(P1.ID, INPUT); // Starting up INPUT pins 
   pinMode(P2.ID, INPUT);
   pinMode(P3.ID, INPUT);
 
   pinMode(BRB_pin, INPUT_PULLUP); // The Waiting Button
+
+  Profile_Select(DEFAULT_PROFILE);
+  Temperature_Sample();
+  randomSeed(micros() ^ analogRead(P1.ID)); // Scan orders of the robust mode, see Scan_Vote
 }
 
 void loop()
 {
   if(buttonPressed)
   {
-    Serial.println(""); // Newline
-    Serial.println(""); // Newline
-    Serial.println("NEW MEASURE:");
-    byte dut_flag = identify(0, P1, P2, P3);
+    if(attr::Output_Mode == TEXT_MODE)
+    {
+      Link.println(); // Newline
+      Link.println(); // Newline
+      Link.println(F("NEW MEASURE:"));
+    }
 
-    switch (dut_flag)
+    Result DUT;
+    identify(DUT, 0);
+
+    if(attr::Output_Mode == BINARY_MODE)
+    {
+      Send_Result(0, DUT); // Queued, the interrupt sends it while we carry on
+    }
+    else
     {
-      case BJT_FLAG: // 2
-          Serial.println(" DEVICE: Unidentified BJT ");
-          break; 
-
-      case MOS_FLAG: // 3
-          Serial.println(" DEVICE: Unidentified MOS ");
-          break; 
-
-      case NPN_FLAG: // 4
-      case PNP_FLAG: // 5
-      case NMOS_ENH_FLAG: // 6
-      case NMOS_DEP_FLAG: // 7
-      case PMOS_ENH_FLAG: // 8
-      case PMOS_DEP_FLAG: // 9
-          display(attr::Semiconductor, dut_flag);
-          break;
-
-      case DIODE_AC_FLAG: // 1 << 4 (16)
-        display(attr::Diode, dut_flag);
-        break; 
-
-      case DIODE_CA_FLAG: // 1 << 4 + 1 (17)
-        display(attr::Diode, dut_flag);
-        break; 
-
-      case CAPACITOR_FLAG: // 1 << 5 (32)
-        display(attr::Capacitor, dut_flag);
-        break; 
-
-      case INDUCTOR_FLAG: // 1 << 6 (64)
-        display(attr::Inductor, dut_flag);
-        break; 
-
-      case RESISTOR_FLAG: // 1 << 7 (128)
-        display(attr::Resistor, dut_flag);
-        break; 
-
-      case SHORT_CIRCUIT_FLAG: // 15
-        Serial.println(" SHORTED PROBES ");
-        break;  
-
-      case OPEN_CIRCUIT_FLAG: // 240
-        Serial.println("DEVICE: Open Circuit");
-        break;          
-      
-      default:
-        Serial.println("MEASUREMENT ERROR");
-        break;
+      display(DUT);
     }
     buttonPressed = false;
   }
 
-  buttonPressed = !digitalRead(BRB_pin); // Set flag if button is pressed (reading is LOW)
-  waitmsg(buttonPressed);
+  buttonPressed = button(); // Set flag if button is pressed, a long press selects the next profile instead
+  bool commanded = Command_Poll(); // Serial commands, see command.cpp
+  if(attr::Output_Mode == TEXT_MODE){ waitmsg(buttonPressed || commanded); }
+}
+
+// Short press of the button (reading is LOW), 1 once released. A long press selects the next profile, returning 0.
+bool button()
+{
+  if(digitalRead(BRB_pin)){ return 0; }
+
+  unsigned long pressed = millis();
+  while(!digitalRead(BRB_pin))
+  {
+    if(millis() - pressed >= LONG_PRESS_MS)
+    {
+      Profile_Next();
+      if(attr::Output_Mode == TEXT_MODE){ display_profile(attr::Profile.Id); }
+      while(!digitalRead(BRB_pin)){} // Until released
+      return 0;
+    }
+  }
+  return 1;
 }
 
 void waitmsg( bool buttonPressed )
@@ -129,8 +116,8 @@ void waitmsg( bool buttonPressed )
 
   if(!repeats)
   {
-    Serial.println(""); // Newline
-    Serial.println("Waiting Button Press");
+    Link.println(); // Newline
+    Link.println(F("Waiting Button Press"));
     repeats = 10;
   }
 
@@ -138,7 +125,7 @@ void waitmsg( bool buttonPressed )
 
   if(currentTime - lastTime >= 5000)
   {
-    Serial.print(" . ");
+    Link.print(F(" . "));
     repeats --;
     lastTime = currentTime;
   }
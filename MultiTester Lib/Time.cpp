@@ -14,7 +14,7 @@
   * Low resistances at pins 5 / 8 / 11
   * The way we connected the pins ( A1 = 15 | 5,6,7 )( A2 = 16 | 8,9,10 )( A3 = 17 | 11,12,13 )
   */
-byte InductorTMeasure(Probe probeA, Probe probeB, _Bool I_Mode, unsigned long *time){
+byte InductorTMeasure(const Probe &probeA, const Probe &probeB, _Bool I_Mode, unsigned long *time){
 
   // ShuntPin has our Resistance connected to probe B which is the one that makes the measurement
   // Initializing variables:
@@ -66,6 +66,9 @@ byte InductorTMeasure(Probe probeA, Probe probeB, _Bool I_Mode, unsigned long *t
 
   delay(10); // Allow bandgap reference to settle
 
+  unsigned long Allowed = Budget_ms(IND_TIMEOUT_MS); // Max Waiting time, or what is left of the budget
+  int MaxOverflows = Allowed / 4.096;
+
   // Timer
   OverflowTicks = 0;                    // reset overflow counter
   TCCR1A = 0;                           // set default mode
@@ -93,9 +96,10 @@ byte InductorTMeasure(Probe probeA, Probe probeB, _Bool I_Mode, unsigned long *t
       OverflowTicks ++;                 // Increase Overflow count
     }
 
-    if (OverflowTicks == 160) // Max Waiting time (655ms)
+    if (OverflowTicks >= MaxOverflows) // Max Waiting time (655ms, see IND_TIMEOUT_MS)
       {
         TOUT = 1;
+        Budget_Timeout(Allowed, IND_TIMEOUT_MS);
         break; //Stop the loop
       }
   }
@@ -113,7 +117,7 @@ byte InductorTMeasure(Probe probeA, Probe probeB, _Bool I_Mode, unsigned long *t
 
   Count += OverflowTicks * 4096000; // Adding the overflow ticks
 
-  // Serial.println(time); // Debug and Calibration Purposes, uncomment to print the ticks
+  // Link.println(time); // Debug and Calibration Purposes, uncomment to print the ticks
 
   /* 
    * We introduce an offset to account for clock cycles used by delay and the loop
@@ -142,7 +146,7 @@ byte InductorTMeasure(Probe probeA, Probe probeB, _Bool I_Mode, unsigned long *t
   return 0; //Successful
 }
 
-byte CapacitorTMeasure(Probe probeA, Probe probeB, byte R_Mode, unsigned long *time)
+byte CapacitorTMeasure(const Probe &probeA, const Probe &probeB, byte R_Mode, unsigned long *time)
 {
    /*
    * Measures the time needed for a capacitor to charge to VCC from a voltage
@@ -194,6 +198,9 @@ byte CapacitorTMeasure(Probe probeA, Probe probeB, byte R_Mode, unsigned long *t
 
   delay(10); // Allow bandgap reference to settle
 
+  unsigned long Allowed = Budget_ms(CAP_TIMEOUT_MS); // Max Waiting time, or what is left of the budget
+  int MaxOverflows = Allowed / 4.096;
+
   // Timer
   OverflowTicks = 0;                    // reset overflow counter
   TCCR1A = 0;                           // set default mode
@@ -221,10 +228,11 @@ byte CapacitorTMeasure(Probe probeA, Probe probeB, byte R_Mode, unsigned long *t
       OverflowTicks ++;                 // Increase Overflow count
     }
 
-    if (OverflowTicks == 500) // Max Waiting time 2s
+    if (OverflowTicks >= MaxOverflows) // Max Waiting time 2s (CAP_TIMEOUT_MS)
       {
         TOUT = 1;
-        //Serial.print("Timeout");
+        Budget_Timeout(Allowed, CAP_TIMEOUT_MS);
+        //Link.print("Timeout");
         break; //Stop the loop
       }
   }
@@ -237,7 +245,7 @@ byte CapacitorTMeasure(Probe probeA, Probe probeB, byte R_Mode, unsigned long *t
   pinMode(Pullup, INPUT);
   pinMode(ShuntPin, INPUT);
   Count += OverflowTicks * 4096000; // Adding the overflow ticks
-  // Serial.println(time); // Debug and Calibration Purposes, uncomment to print the ticks
+  // Link.println(time); // Debug and Calibration Purposes, uncomment to print the ticks
   /* 
    * We introduce an offset to account for clock cycles used by delay and the loop
    * This is a calibration made when shorting the pins together, as a wire must return 0ns.
@@ -263,4 +271,262 @@ byte CapacitorTMeasure(Probe probeA, Probe probeB, byte R_Mode, unsigned long *t
   return 0; //Successful
 }
 
+byte InductorWaveform(const Probe &probeA, const Probe &probeB, _Bool I_Mode, unsigned int period_us, unsigned int *V, byte n)
+{
+  /*
+   * Samples the current rise of an inductor during a single pulse, as the voltage across the shunt of probe B
+   * (Rl + Ri_L, or Ri_L alone in high current mode, wired as in InductorTMeasure).
+   * The ADC is auto triggered (ADATE) by the Timer 1 Compare Match B, with the timer in CTC mode, so the samples are
+   * exactly "period_us" apart (16 us at least: 13 ADC clocks of 1 us, prescaler 16, plus the trigger).
+   * The pulse starts just before the first sample, the fit does not need to know when.
+   */
+  _Bool TOUT = 0;                // Timeout Flag
+  byte ShuntPin = probeB.Rl;
+
+  if (I_Mode){                  // 1 for High Current (Low Resistance), 0 for Low Current (High Resistance).
+    pinMode(ShuntPin, INPUT);   // No Shunt Resistor
+    pinMode(probeA.ID, OUTPUT);
+    pinMode(probeB.ID, OUTPUT); // Pull down probeB directly (we have a ~25 Ohm internal resistance)
+
+    digitalWrite(probeA.ID, LOW);
+    digitalWrite(probeB.ID, LOW);
+  }
+  else{
+    pinMode(ShuntPin, OUTPUT); // Shunt Resistor Enabled (680 Ohms)
+    pinMode(probeA.ID, OUTPUT);
+    pinMode(probeB.ID, INPUT); // Probe B will monitor the values but no current will flow through it.
+
+    digitalWrite(ShuntPin, LOW);
+    digitalWrite(probeA.ID, LOW);
+  }
+
+  // ADC: probe B against AVcc | Enabled, auto triggered, prescaler 16 (1 MHz) | Trigger: Timer 1 Compare Match B
+  ADMUX = (1 << REFS0) | (probeB.ID - 14);
+  ADCSRA = (1 << ADEN) | (1 << ADATE) | (1 << ADIF) | (1 << ADPS2);
+  ADCSRB = (1 << ADTS2) | (1 << ADTS0);
+
+  // Timer: CTC on OCR1A with 0.5 us ticks, Compare Match B at the top
+  TCCR1A = 0;
+  TCCR1B = (1 << WGM12);
+  TCNT1 = 0;
+  OCR1A = 2 * period_us - 1;
+  OCR1B = OCR1A;
+  TIFR1 = (1 << ICF1) | (1 << OCF1B) | (1 << OCF1A) | (1 << TOV1);
+  TCCR1B |= (1 << CS11); // Start Timer on 1:8 clk divider
+
+  digitalWrite(probeA.ID, HIGH);
+
+  unsigned long start = micros();
+  for (byte i = 0; i < n && !TOUT; i++)
+  {
+    while (!(ADCSRA & (1 << ADIF)))
+    {
+      if (micros() - start > 2UL * n * period_us + 1000) {TOUT = 1; break;} // The trigger never came
+    }
+    V[i] = ADC;
+    ADCSRA |= (1 << ADIF);                // Clearing the conversion flag
+    TIFR1 = (1 << OCF1B);                 // And the compare flag, or the next match does not trigger
+  }
+
+  digitalWrite(probeA.ID, LOW); // Stop Current Flow as soon as possible
+  TCCR1B = 0;                           // stop Timer
+  delay(10);
+  // Reset all used pins
+  pinMode(probeA.ID, INPUT);
+  pinMode(ShuntPin,  INPUT);
+  pinMode(probeB.ID, INPUT);
+
+  // Reset Everything
+  ADCSRA= 135;
+  ADCSRB= 0;
+  TCCR1A= 1;
+  TCCR1B= 3;
+  TIFR1= 39;
+
+  if (TOUT) {return 10;}  // Timeout Flag
+  return 0; //Successful
+}
+
+byte ResonanceTMeasure(const Probe &probeA, const Probe &probeB, unsigned int *t, byte n, byte *edges)
+{
+  /*
+   * Rings an inductor between probe A (LC_PROBE) and probe B against the reference capacitor and timestamps the
+   * zero crossings. Probe B is held LOW and the reference capacitor is switched onto probe A (LC_REF_PIN), so it
+   * sits across the inductor. A current is built up through the Rl of probe A and then released: the tank rings
+   * around 0V with an amplitude of I0 sqrt(L/C), a few hundred mV at most, below the clamping of the pin diodes.
+   *
+   * The comparator compares the two ends of the inductor: AIN0 (D6) is the Rm pin of probe A, which reads its node
+   * through the 22k while it is an input, and the negative input is probe B through the ADC multiplexer. Its
+   * rising edges are captured by Timer 1, the first "n" timestamps are stored in t (1/16 us) and all of them counted
+   * in *edges, until no crossing comes for LC_GAP_TICKS.
+   */
+  byte count = 0;
+
+  pinMode(probeA.ID, INPUT);
+  pinMode(probeA.Rm, INPUT);           // AIN0
+  pinMode(probeB.ID, OUTPUT);
+  digitalWrite(probeB.ID, LOW);
+  pinMode(LC_REF_PIN, OUTPUT);
+  digitalWrite(LC_REF_PIN, HIGH);      // Reference capacitor in
+
+  pinMode(probeA.Rl, OUTPUT);
+  digitalWrite(probeA.Rl, HIGH);       // Building up the current through the inductor
+
+  ADCSRA = (0<<ADEN); // Switch off the ADC, needed to start the comparator
+  ADCSRB = (1<<ACME); // Use Analog Multiplexed Input (To compare through pinB)
+
+  // Setting up the analog comparator: enabling it | AIN0 as positive input | Clearing Interrupts | Disabling interrupts | Enabling Input Capture
+  ACSR = (0 << ACD) | (0 << ACBG) | (1 << ACI) | (0 << ACIE) | (1 << ACIC);
+  ADMUX = probeB.ID - 14; //Ax has a value of 14 + x, as A0 = 14 = 0xe (given there are 13 digital pins)
+
+  delay(1); // The current settles in L / 700 Ohms, some us
+
+  // Timer
+  TCCR1A = 0;                           // set default mode
+  TCCR1B = (1 << ICES1);                // Capture on the rising edge of the comparator
+  TCNT1 = 0;                            // Reset counter
+  TIFR1 = (1 << ICF1) | (1 << OCF1B) | (1 << OCF1A) | (1 << TOV1);
+  TCCR1B |= (1 << CS10); // Start Timer on 1:1 clk divider
+
+  pinMode(probeA.Rl, INPUT);            // Released, the tank rings
+
+  unsigned int last = TCNT1;
+  while (count < 250)
+  {
+    if (TIFR1 & (1 << ICF1))
+    {
+      last = ICR1;
+      TIFR1 = (1 << ICF1);
+      if (count < n) {t[count] = last;}
+      count ++;
+    }
+    else if ((unsigned int) (TCNT1 - last) > LC_GAP_TICKS) {break;} // Rung out
+  }
+
+  TCCR1B = 0;                           // stop Timer
+  *edges = count;
+
+  // Reset all used pins
+  digitalWrite(LC_REF_PIN, LOW);       // Reference capacitor out
+  pinMode(LC_REF_PIN, INPUT);
+  pinMode(probeB.ID, INPUT);
+
+  // Reset Everything
+  ADCSRA= 135;
+  ADCSRB= 0;
+  TCCR1A= 1;
+  TCCR1B= 3;
+  TIFR1= 39;
+
+  if (count < 3) {return 1;}  // No ringing, not an inductor (or overdamped)
+  return 0; //Successful
+}
+
+byte ChargeTMeasure(const Probe &probe, byte Shunt, byte cycles, byte overflows, unsigned long *time)
+{
+  /*
+   * Measures the time a probe node takes to charge from 0V to the Internal BandGap Reference through one of
+   * its shunts (SHUNT_M or SHUNT_H), with the other lead of the part held at GND by the caller. The comparator
+   * output drives the Timer 1 input capture, so the crossing is latched in ICR1 by the hardware.
+   * Used for MOSFET gates (below the bandgap the channel stays off and the gate only sees Ciss) and for small
+   * capacitors. The node is charged "cycles" times, discharging through Rl in between, and the mean time is
+   * returned: summing the cycles gives the small capacitances a resolution finer than one clock.
+   * Each cycle may take "overflows" timer overflows (4.096 ms) at most.
+   */
+  int OverflowTicks = 0;         // Overflow counter
+  int Offset = 4375;             // Nanosecond Offset due to processing (the call to digitalWrite)
+  long Count = 0;                // Time Counter
+  _Bool TOUT = 0;                // Timeout Flag
+  byte ShuntPin = (Shunt == SHUNT_M) ? probe.Rm : probe.Rh;
+
+  // Discharging the node through Rl before starting
+  pinMode(probe.ID, INPUT);
+  pinMode(probe.Rl, OUTPUT);
+  pinMode(ShuntPin, OUTPUT);
+  digitalWrite(probe.Rl, LOW);
+  digitalWrite(ShuntPin, LOW);
+
+  ADCSRA = (0<<ADEN); // Switch off the ADC, needed to start the comparator
+  ADCSRB = (1<<ACME); // Use Analog Multiplexed Input (To compare through the probe)
+
+  // Setting up the analog comparator: enabling it | Internal bandgap reference | Clearing Interrupts | Disabling interrupts | Enabling Input Capture
+  ACSR = (0 << ACD) | (1 << ACBG) | (1 << ACI) | (0 << ACIE) | (1 << ACIC);
+  ADMUX = probe.ID - 14; //Ax has a value of 14 + x, as A0 = 14 = 0xe (given there are 13 digital pins)
+
+  delay(1); // Allow bandgap reference to settle (70us at most), and the node to discharge
+
+  for (byte i = 0; i < cycles && !TOUT; i++)
+  {
+    pinMode(probe.Rl, INPUT);
+
+    // Timer
+    OverflowTicks = 0;
+    TCCR1A = 0;                           // set default mode
+    TCCR1B = 0;                           // Capture on the falling edge of the comparator (node rising above the bandgap)
+    TCNT1 = 0;                            // Reset counter
+    ICR1 = 0;
+
+    // Clearing all flags (Input Capture , Output Compare B , Output Compare A , Overflow Flag)
+    TIFR1 = (1 << ICF1) | (1 << OCF1B) | (1 << OCF1A) | (1 << TOV1);
+    TCCR1B |= (1 << CS10); // Start Timer on 1:1 clk divider
+
+    digitalWrite(ShuntPin, HIGH);
+
+    // Time Loop:
+    while(1){
+      if(TIFR1 & (1 << ICF1)){break;}    // Captured
+
+      if (TIFR1 & (1 << TOV1))
+      {
+        // Overflow at 4.096 ms for 16 MHz
+        TIFR1 = (1 << TOV1);              // Reset Overflow Flag
+        wdt_reset();                      // Reset Watchdog to avoid timeout
+        OverflowTicks ++;                 // Increase Overflow count
+      }
+
+      if (OverflowTicks >= overflows) // Max Waiting time
+        {
+          TOUT = 1;
+          break; //Stop the loop
+        }
+    }
+
+    TCCR1B = 0;                           // stop Timer
+    // An overflow may have happened just before a capture near the top: it is only ours if the capture is low
+    if ((TIFR1 & (1 << TOV1)) && ICR1 < 0x8000) {OverflowTicks ++;}
+    TIFR1 = (1 << ICF1);                  // reset Input Capture flag
+    Count += ICR1*62.5 + OverflowTicks * 4096000; // Timer value, adding the overflow ticks
+
+    // Discharging the node for the next cycle
+    digitalWrite(ShuntPin, LOW);
+    pinMode(probe.Rl, OUTPUT);
+    digitalWrite(probe.Rl, LOW);
+    delayMicroseconds(10); // 5 time constants of Rl with 3 nF
+  }
+
+  // Reset all used pins
+  delay(1); // Large gates, or nodes charged far through a part that is not a capacitor
+  pinMode(probe.Rl, INPUT);
+  pinMode(ShuntPin, INPUT);
+
+  Count /= cycles;
+  if (Count < Offset) {Count = 0;} // If we measure a time shorter than Offset, we set the minimum time possible (0)
+  else {Count -= Offset;}
+
+  *time = Count;                 // Storing the time value
+
+  // Reset Everything
+  ADCSRA= 135;
+  ADCSRB= 0;
+  TCCR1A= 1;
+  TCCR1B= 3;
+  TIFR1= 39;
+
+  if (TOUT)                 {return 10;}  // Timeout Flag
+  if (Count == 0)           {return 1;}   // No Time Flag
+  if (Count < 1000)         {return 2;}   // Low Time Flag
+
+  return 0; //Successful
+}
+
 #undef TIME_CPP
\ No newline at end of file
@@ -0,0 +1,56 @@
+#define BUDGET_CPP
+
+#include "common.h"
+#include "config.h"
+#include "functions.h"
+
+/*
+ * Time budget of a measurement. identify() gives itself attr::Budget ms, and every phase with a timeout of its own
+ * (the discharge wait, the capacitor and inductor timings, the MOSFET ramps, the resistance averaging) asks
+ * Budget_ms() for its share: its own limit, or whatever is left if that is less. The phases cut their sample
+ * counts or drop their optional values when short, and say so with Budget_Partial(); the worst reason ends up in
+ * the Partial field of the result. Outside identify() there is no budget, every phase keeps its own limit.
+ */
+
+static unsigned long Deadline = 0;  // millis() at which the budget runs out
+static bool Running = 0;
+static byte Reason = PARTIAL_NONE;
+
+// Starts a budget of "ms" (0 for none).
+void Budget_Start(unsigned int ms)
+{
+    Running = (ms != 0);
+    Deadline = millis() + ms;
+    Reason = PARTIAL_NONE;
+}
+
+// Ends the budget, returning the worst reason a value was cut for (PARTIAL_ defines).
+byte Budget_End()
+{
+    Running = 0;
+    return Reason;
+}
+
+// Time a phase limited to "phase_ms" may take (ms), 0 once the budget is spent.
+unsigned long Budget_ms(unsigned long phase_ms)
+{
+    if(!Running){ return phase_ms; }
+
+    long left = Deadline - millis();
+    if(left <= 0){ return 0; }
+    return min((unsigned long) left, phase_ms);
+}
+
+// Records why a result is partial, keeping the worst reason.
+void Budget_Partial(byte reason)
+{
+    if(reason > Reason){ Reason = reason; }
+}
+
+// A phase timed out after "allowed_ms": partial if the budget, not its own limit "phase_ms", cut it.
+void Budget_Timeout(unsigned long allowed_ms, unsigned long phase_ms)
+{
+    if(allowed_ms < phase_ms){ Budget_Partial(PARTIAL_TIMEOUT); }
+}
+
+#undef BUDGET_CPP
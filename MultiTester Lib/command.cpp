@@ -0,0 +1,501 @@
+#define COMMAND_CPP
+
+#include "common.h"
+#include "config.h"
+#include "functions.h"
+
+/*
+ * Serial command interface, for measurements driven by a fixture PC instead of the button.
+ *
+ * Commands are lines of space separated words, optionally preceded by a numeric request ID (0-255)
+ * which is repeated in the reply, so requests can be pipelined. Lines are collected from the receive
+ * buffer of the link, so they keep arriving while a measurement runs and are executed in order.
+ *
+ *  [id] identify               Full identification, as the button does
+ *  [id] res <a> <b> <l|m|h|a>  Resistance between probes a and b (1-3), using the shunt of probe a, or the one
+ *                              predicted to be the most precise (a, reported with its uncertainty)
+ *  [id] cap <a> <b> <l|m|h>    Capacitance between probes a and b. Range hint: shunt of probe b,
+ *                              l for big capacitors, m by default, h for small ones
+ *  [id] leak [seconds]         Identifies a capacitor and measures its leakage (in 10 s at most by default) and
+ *                              dielectric absorption. Positive lead on the lower numbered probe
+ *  [id] repeat <n> <command>   Runs the command n times, every result is sent as soon as it is ready
+ *  [id] samples <n>            Number of ADC readings averaged per resistance value (1-255), in the profile in use
+ *  [id] profile <name>         Measurement profile: fast, balanced or precise (see profile.cpp)
+ *  [id] budget <ms>            Time an identification may take, 0 for no limit (see budget.cpp)
+ *  [id] robust <n>             Identifications repeat the scan until n of them agree, 0 for a single scan (see Scan_Vote)
+ *  [id] sweep <n> [rounds]     Measures the parts on multiplexer sockets 1 to n, rounds times (1 by default)
+ *  [id] curve                  Identifies a BJT and traces hFE over Ic and Ic - Vce into saturation, streaming
+ *                              every point (see curve.cpp)
+ *  [id] meter                  Identifies a resistor, capacitor or inductor, then streams its averaged value on every
+ *                              change until any character is sent (see meter.cpp)
+ *  [id] scan                   Conduction paths between all the probes (resistor arrays, dual diodes, ...)
+ *  [id] cal [stray]            Dumps the probe calibration (at the die temperature, which it gives too), or measures
+ *                              the stray capacitances between the probes (nothing inserted) and stores them in EEPROM
+ *  [id] mode <text|bin>        Selects the output mode
+ *
+ * Replies: in TEXT_MODE the ID followed by the usual report, or by "OK"/"ERR <code>".
+ * In BINARY_MODE a result frame carrying the ID (REPLY_OK_FLAG, REPLY_ERROR_FLAG, CALIBRATION_FLAG,
+ * NETWORK_FLAG and CURVE_FLAG for the replies that are not identifications).
+ */
+
+// Error codes, sent as the value of REPLY_ERROR_FLAG frames
+#define CMD_UNKNOWN         1   // Unknown command
+#define CMD_BAD_ARGUMENT    2   // Missing or out of range argument
+#define CMD_LINE_TOO_LONG   3
+#define CMD_MEASURE_FAILED  4   // The measurement returned an error flag
+
+static char line[CMD_LINE_LENGTH];
+static byte line_length = 0;
+static bool line_overflow = 0;
+
+// Probes are numbered as on the board (1-3)
+static const Probe *probe_number(const char *arg)
+{
+    if(!arg){ return 0; }
+
+    int n = atoi(arg);
+    if(n < 1 || n > PROBE_COUNT){ return 0; }
+    return Probes[n - 1];
+}
+
+static void reply_ok(byte request)
+{
+    if(attr::Output_Mode == BINARY_MODE)
+    {
+        Result reply;
+        reply.clear();
+        reply.Flag = REPLY_OK_FLAG;
+        Send_Frame(request, reply, 0);
+        return;
+    }
+    Link.print(request); Link.println(F(" OK"));
+}
+
+static void reply_error(byte request, byte code)
+{
+    if(attr::Output_Mode == BINARY_MODE)
+    {
+        Result reply;
+        reply.clear();
+        reply.Flag = REPLY_ERROR_FLAG;
+        reply.Value[0] = code;
+        Send_Frame(request, reply, 1);
+        return;
+    }
+    Link.print(request); Link.print(F(" ERR ")); Link.println(code);
+}
+
+static void reply_result(byte request, const Result &DUT)
+{
+    if(attr::Output_Mode == BINARY_MODE)
+    {
+        Send_Result(request, DUT);
+        return;
+    }
+    Link.print(request); Link.print(' ');
+    if(DUT.Socket){ Link.print('S'); Link.print(DUT.Socket); Link.print(' '); }
+    display(DUT);
+}
+
+// Meter updates: the value alone in TEXT_MODE, as they come tens of times a second.
+static void reply_reading(byte request, const Result &DUT)
+{
+    if(attr::Output_Mode == BINARY_MODE)
+    {
+        Send_Result(request, DUT);
+        return;
+    }
+    Link.print(request); Link.print(' ');
+    Link.print(DUT.Value[0], 4); Link.print(' ');
+    if(DUT.Power != ' '){ Link.print(DUT.Power); }
+    if      (DUT.Flag == RESISTOR_FLAG) { Link.print(F("Ohms")); }
+    else if (DUT.Flag == CAPACITOR_FLAG){ Link.print('F'); }
+    else                                { Link.print('H'); }
+    if(DUT.Uncertainty){ Link.print(F(" +- ")); Link.print(DUT.Uncertainty, 4); }
+    Link.println();
+}
+
+static void dump_calibration(byte request)
+{
+    Result reply;
+    reply.clear();
+    reply.Flag = CALIBRATION_FLAG;
+    Temperature_Update(); // The values below are given at the temperature in attr::Thermal
+
+    for(byte i = 0; i < PROBE_COUNT; i++)
+    {
+        if(attr::Output_Mode == BINARY_MODE)
+        {
+            reply.Pins[0]  = Probes[i]->ID;
+            reply.Value[0] = Probes[i]->Rl_val();
+            reply.Value[1] = Probes[i]->Rm_val();
+            reply.Value[2] = Probes[i]->Rh_val();
+            Send_Frame(request, reply, 3);
+        }
+        else
+        {
+            Link.print(request); Link.print(F(" P")); Link.print(i+1);
+            Link.print(F(": Rl = ")); Link.print(Probes[i]->Rl_val());
+            Link.print(F(" Ohms, Rm = ")); Link.print(Probes[i]->Rm_val());
+            Link.print(F(" kOhms, Rh = ")); Link.print(Probes[i]->Rh_val()); Link.println(F(" kOhms"));
+        }
+    }
+
+    if(attr::Output_Mode == BINARY_MODE)
+    {
+        reply.Pins[0]  = 0;
+        reply.Value[0] = INTERNAL_R_LOW;
+        reply.Value[1] = INTERNAL_R_HIGH;
+        reply.Value[2] = attr::Thermal.Celsius;
+        Send_Frame(request, reply, 3);
+    }
+    else
+    {
+        Link.print(request); Link.print(F(" Internal R: Low = ")); Link.print(INTERNAL_R_LOW);
+        Link.print(F(" Ohms, High = ")); Link.print(INTERNAL_R_HIGH); Link.println(F(" Ohms"));
+        Link.print(request); Link.print(F(" Die temperature = ")); Link.print(attr::Thermal.Celsius, 1); Link.println(F(" C"));
+    }
+
+    // Stray capacitances, by ordered pair (the second probe is the one charged)
+    Role_Map Pair(2);
+    do
+    {
+        byte a = Pair.Index[ROLE_A];
+        byte b = Pair.Index[ROLE_B];
+        if(attr::Output_Mode == BINARY_MODE)
+        {
+            reply.Pins[0]  = Probes[a]->ID;
+            reply.Pins[1]  = Probes[b]->ID;
+            reply.Value[0] = Stray_pF(a, b);
+            Send_Frame(request, reply, 1);
+        }
+        else
+        {
+            Link.print(request); Link.print(F(" Stray P")); Link.print(a+1); Link.print(F(" > P")); Link.print(b+1);
+            Link.print(F(" = ")); Link.print(Stray_pF(a, b)); Link.println(F(" pF"));
+        }
+    } while(Pair.next());
+}
+
+/*
+ * Scans every probe and lists the links found: "1-2 R" for current both ways (resistor, inductor, short),
+ * "1>3 D" for a diode with its anode on probe 1. In BINARY_MODE one NETWORK_FLAG frame per link (pins of
+ * both ends, value 1 if both ways) followed by an OK.
+ */
+static void command_scan(byte request)
+{
+    Scan S;
+    if(Probe_Scan(S, PROBE_COUNT, 0)){ reply_error(request, CMD_MEASURE_FAILED); return; }
+
+    Result link;
+    link.clear();
+    link.Flag = NETWORK_FLAG;
+
+    for(byte a = 0; a < PROBE_COUNT; a++)
+    {
+        for(byte b = 0; b < PROBE_COUNT; b++)
+        {
+            bool forward = (S.Link[a] >> b) & 1;
+            bool reverse = (S.Link[b] >> a) & 1;
+
+            if(!forward || (reverse && b < a)){ continue; } // Each resistive link once
+
+            if(attr::Output_Mode == BINARY_MODE)
+            {
+                link.Pins[ROLE_A] = Probes[a]->ID;
+                link.Pins[ROLE_B] = Probes[b]->ID;
+                link.Value[0] = reverse;
+                Send_Frame(request, link, 1);
+            }
+            else
+            {
+                Link.print(request); Link.print(' ');
+                Link.print(a + 1); Link.print(reverse ? '-' : '>'); Link.print(b + 1);
+                Link.println(reverse ? F(" R") : F(" D"));
+            }
+        }
+    }
+    reply_ok(request);
+}
+
+// Resistance between two probes with the chosen shunt, skipping the identification.
+static void command_res(byte request, byte argc, char **argv)
+{
+    const Probe *A = probe_number(argc > 1 ? argv[1] : 0);
+    const Probe *B = probe_number(argc > 2 ? argv[2] : 0);
+    char shunt = argc > 3 ? argv[3][0] : 'l';
+
+    if(!A || !B || A == B){ reply_error(request, CMD_BAD_ARGUMENT); return; }
+
+    Result DUT;
+    DUT.clear();
+    unsigned long start = millis();
+
+    switch (shunt)
+    {
+        case 'l':
+            DUT.Value[V_RESISTANCE] = Resistance_Measure(A->Rl, B->ID, A->Rl_val(), A->ID, 0, 0);
+            break;
+        case 'm':
+            DUT.Value[V_RESISTANCE] = Resistance_Measure(A->Rm, B->ID, A->Rm_val(), A->ID, 0, 1);
+            DUT.Power = 'k';
+            break;
+        case 'h':
+            DUT.Value[V_RESISTANCE] = Resistance_Measure(A->Rh, B->ID, A->Rh_val(), A->ID, 0, 1);
+            DUT.Power = 'k';
+            break;
+        case 'a':
+            Resistance_Auto(DUT, *A, *B, -1);
+            break;
+        default:
+            reply_error(request, CMD_BAD_ARGUMENT);
+            return;
+    }
+    DUT.Flag = RESISTOR_FLAG;
+    DUT.Pins[ROLE_A] = A->ID;
+    DUT.Pins[ROLE_B] = B->ID;
+    DUT.Profile = attr::Profile.Id;
+    DUT.Elapsed = millis() - start;
+
+    reply_result(request, DUT);
+}
+
+// Capacitance between two probes, the range hint selects the charging shunt.
+static void command_cap(byte request, byte argc, char **argv)
+{
+    const Probe *A = probe_number(argc > 1 ? argv[1] : 0);
+    const Probe *B = probe_number(argc > 2 ? argv[2] : 0);
+    char range = argc > 3 ? argv[3][0] : 'm';
+    byte R_Mode = 1;
+
+    if(!A || !B || A == B){ reply_error(request, CMD_BAD_ARGUMENT); return; }
+
+    if      (range == 'l'){ R_Mode = 0; }
+    else if (range == 'm'){ R_Mode = 1; }
+    else if (range == 'h'){ R_Mode = 2; }
+    else { reply_error(request, CMD_BAD_ARGUMENT); return; }
+
+    Result DUT;
+    DUT.clear();
+    unsigned long start = millis();
+
+    pinMode(A->Rl, OUTPUT); // Discharging before the measure
+    pinMode(B->Rl, OUTPUT);
+    digitalWrite(A->Rl, LOW);
+    digitalWrite(B->Rl, LOW);
+    bool Timeout = wait_discharge(A->ID, B->ID, B->ID);
+    pinMode(A->Rl, INPUT);
+    pinMode(B->Rl, INPUT);
+
+    unsigned long time = 0;
+    if(Timeout || CapacitorTMeasure(*A, *B, R_Mode, &time))
+    {
+        reply_error(request, CMD_MEASURE_FAILED);
+        return;
+    }
+
+    DUT.Value[V_CAPACITANCE] = Capacitor_Value(DUT, *A, *B, R_Mode, time);
+    DUT.Flag = CAPACITOR_FLAG;
+    DUT.Pins[ROLE_A] = A->ID;
+    DUT.Pins[ROLE_B] = B->ID;
+    DUT.Profile = attr::Profile.Id;
+    DUT.Elapsed = millis() - start;
+
+    reply_result(request, DUT);
+}
+
+static void run(byte request, byte argc, char **argv)
+{
+    if(argc == 0){ return; }
+
+    const char *cmd = argv[0];
+
+    if(!strcmp_P(cmd, PSTR("identify")))
+    {
+        Result DUT;
+        identify(DUT, 0);
+        reply_result(request, DUT);
+    }
+    else if(!strcmp_P(cmd, PSTR("res")))
+    {
+        command_res(request, argc, argv);
+    }
+    else if(!strcmp_P(cmd, PSTR("cap")))
+    {
+        command_cap(request, argc, argv);
+    }
+    else if(!strcmp_P(cmd, PSTR("leak")))
+    {
+        long seconds = argc > 1 ? atol(argv[1]) : LEAK_WINDOW_MS / 1000;
+        if(seconds < 1 || seconds > 3600){ reply_error(request, CMD_BAD_ARGUMENT); return; }
+
+        Result DUT;
+        unsigned long start = millis();
+        identify(DUT, 0);
+        if(Capacitor_Leakage(DUT, seconds * 1000)){ reply_error(request, CMD_MEASURE_FAILED); return; } // Not a capacitor
+
+        DUT.Elapsed = millis() - start;
+        reply_result(request, DUT);
+    }
+    else if(!strcmp_P(cmd, PSTR("repeat")))
+    {
+        int n = argc > 2 ? atoi(argv[1]) : 0;
+        if(n <= 0 || !strcmp_P(argv[2], PSTR("repeat"))){ reply_error(request, CMD_BAD_ARGUMENT); return; }
+
+        Temperature_Update(); // Once for all the runs
+        Temperature_Hold(1);
+        for(int i = 0; i < n; i++)
+        {
+            run(request, argc - 2, argv + 2);
+        }
+        Temperature_Hold(0);
+    }
+    else if(!strcmp_P(cmd, PSTR("samples")))
+    {
+        int n = argc > 1 ? atoi(argv[1]) : 0;
+        if(n < 1 || n > 255){ reply_error(request, CMD_BAD_ARGUMENT); return; }
+
+        attr::Profile.Samples = n;
+        attr::Profile.Id = PROFILE_CUSTOM;
+        reply_ok(request);
+    }
+    else if(!strcmp_P(cmd, PSTR("profile")))
+    {
+        const char *name = argc > 1 ? argv[1] : "";
+        byte id = 0;
+        if      (!strcmp_P(name, PSTR("fast")))     { id = PROFILE_FAST; }
+        else if (!strcmp_P(name, PSTR("balanced"))) { id = PROFILE_BALANCED; }
+        else if (!strcmp_P(name, PSTR("precise")))  { id = PROFILE_PRECISE; }
+
+        if(Profile_Select(id)){ reply_error(request, CMD_BAD_ARGUMENT); return; }
+        reply_ok(request);
+    }
+    else if(!strcmp_P(cmd, PSTR("budget")))
+    {
+        long ms = argc > 1 ? atol(argv[1]) : -1;
+        if(ms < 0 || ms > 60000){ reply_error(request, CMD_BAD_ARGUMENT); return; }
+
+        attr::Budget = ms;
+        reply_ok(request);
+    }
+    else if(!strcmp_P(cmd, PSTR("robust")))
+    {
+        int n = argc > 1 ? atoi(argv[1]) : -1;
+        if(n < 0 || n > CONSENSUS_MAX_SCANS){ reply_error(request, CMD_BAD_ARGUMENT); return; }
+
+        attr::Consensus = n;
+        reply_ok(request);
+    }
+    else if(!strcmp_P(cmd, PSTR("sweep")))
+    {
+        int n = argc > 1 ? atoi(argv[1]) : 0;
+        int rounds = argc > 2 ? atoi(argv[2]) : 1;
+        if(n < 1 || n > MUX_SOCKETS || rounds < 1 || rounds > 255){ reply_error(request, CMD_BAD_ARGUMENT); return; }
+
+        Mux_Sweep(request, n, rounds, reply_result);
+        reply_ok(request);
+    }
+    else if(!strcmp_P(cmd, PSTR("curve")))
+    {
+        Result DUT;
+        identify(DUT, 0);
+        reply_result(request, DUT);
+
+        if(Curve_Trace(request, DUT, reply_result)){ reply_ok(request); }
+        else { reply_error(request, CMD_MEASURE_FAILED); } // Not a BJT
+    }
+    else if(!strcmp_P(cmd, PSTR("meter")))
+    {
+        Result DUT;
+        identify(DUT, 0);
+        reply_result(request, DUT);
+
+        if(!Meter_Run(request, DUT, reply_reading)){ reply_ok(request); }
+        else { reply_error(request, CMD_MEASURE_FAILED); } // Not a resistor, capacitor or inductor, or removed
+    }
+    else if(!strcmp_P(cmd, PSTR("scan")))
+    {
+        command_scan(request);
+    }
+    else if(!strcmp_P(cmd, PSTR("cal")))
+    {
+        if(argc > 1 && !strcmp_P(argv[1], PSTR("stray")))
+        {
+            Calibrate_Stray();
+            reply_ok(request);
+        }
+        else { dump_calibration(request); }
+    }
+    else if(!strcmp_P(cmd, PSTR("mode")))
+    {
+        if     (argc > 1 && !strcmp_P(argv[1], PSTR("text"))){ attr::Output_Mode = TEXT_MODE; }
+        else if(argc > 1 && !strcmp_P(argv[1], PSTR("bin"))) { attr::Output_Mode = BINARY_MODE; }
+        else { reply_error(request, CMD_BAD_ARGUMENT); return; }
+
+        reply_ok(request); // Sent in the new mode
+    }
+    else
+    {
+        reply_error(request, CMD_UNKNOWN);
+    }
+}
+
+// Splits the line into words and runs it.
+static void execute(char *text)
+{
+    char *argv[CMD_MAX_ARGS];
+    byte argc = 0;
+    byte request = 0;
+
+    for(char *word = strtok(text, " \t"); word && argc < CMD_MAX_ARGS; word = strtok(0, " \t"))
+    {
+        argv[argc++] = word;
+    }
+    if(argc == 0){ return; }
+
+    char **args = argv;
+    if(isdigit(argv[0][0])) // Leading request ID
+    {
+        request = atoi(argv[0]);
+        args ++;
+        argc --;
+    }
+
+    run(request, argc, args);
+}
+
+/*
+ * Collects the received characters, running each line once it is complete. Returns 1 if a command
+ * was run. Never waits for input, so it can be called on every turn of loop().
+ */
+bool Command_Poll()
+{
+    bool ran = 0;
+
+    while(Link.available())
+    {
+        char c = Link.read();
+
+        if(c == '\n' || c == '\r')
+        {
+            line[line_length] = '\0';
+
+            if(line_overflow){ reply_error(0, CMD_LINE_TOO_LONG); }
+            else if(line_length){ execute(line); ran = 1; }
+
+            line_length = 0;
+            line_overflow = 0;
+        }
+        else if(line_length < CMD_LINE_LENGTH - 1)
+        {
+            line[line_length++] = c;
+        }
+        else
+        {
+            line_overflow = 1; // The rest of the line is discarded
+        }
+    }
+    return ran;
+}
+
+#undef COMMAND_CPP
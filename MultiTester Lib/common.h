@@ -12,6 +12,7 @@
 #include <stdlib.h>
 #include <stdarg.h>
 #include <string.h>
+#include <ctype.h>
 #include <stdint.h>
 #include <math.h>
 #include <Arduino.h>
@@ -36,9 +37,14 @@ class Probe
     const byte Rl;        // DIGITAL PIN // Low value shunt resistor
     const byte Rm;        // DIGITAL PIN // middle-value shunt resistor (geometric mean of Rl and Rh)
     const byte Rh;        // DIGITAL PIN // High value shunt resistor
-    const float Rl_val;   //In  Ohms
-    const float Rm_val;   //In  kOhms
-    const float Rh_val;   //In  kOhms
+    const float Rl_cal;   //In  Ohms, calibrated at TEMP_CAL_C
+    const float Rm_cal;   //In  kOhms
+    const float Rh_cal;   //In  kOhms
+
+    // Shunt values at the temperature of the measure (see temperature.cpp)
+    float Rl_val() const;
+    float Rm_val() const;
+    float Rh_val() const;
 
 };
 
@@ -48,85 +54,140 @@ const Probe P1 =
 {
   .ID = 15, //A1
   .Rl = 5, .Rm = 6, .Rh = 7,
-  .Rl_val = 663.4,
-  .Rm_val = 21.80,
-  .Rh_val = 677.5,
+  .Rl_cal = 663.4,
+  .Rm_cal = 21.80,
+  .Rh_cal = 677.5,
 };
 
 const Probe P2 = 
 {
   .ID = 16, //A2
   .Rl = 8, .Rm = 9, .Rh = 10,
-  .Rl_val = 662.3,
-  .Rm_val = 21.50,
-  .Rh_val = 677.7,
+  .Rl_cal = 662.3,
+  .Rm_cal = 21.50,
+  .Rh_cal = 677.7,
 };
 
 const Probe P3= 
 {
   .ID = 17, //A3
   .Rl = 11, .Rm = 12, .Rh = 13,
-  .Rl_val = 659.7,
-  .Rm_val = 21.67,
-  .Rh_val = 687.0,
+  .Rl_cal = 659.7,
+  .Rm_cal = 21.67,
+  .Rh_cal = 687.0,
 };
 */
 
 
-// Resistor
-class Resistor_Specs
-{
-  public:
-    float R_Value;
-    char Power;    // For k Ohm scale
-    byte ProbeA;   // Connected probes' IDs
-    byte ProbeB;
-};
+/*
+ * Measurement result. A single record filled by identify() and the measure functions and read by the
+ * outputs, passed by reference all the way. The meaning of the pins and values depends on the Flag:
+ *
+ *  Device          Pins[0]     Pins[1]     Pins[2]     Value[0]        Value[1]        Value[2]        Value[3]
+ *  Resistor        Probe A     Probe B                 R (Power)
+ *  Resistor net    End A       Wiper       End B       R_A (Power)     R_W (Power)     R_B (Power)     Wiper (%)
+ *  Capacitor       Probe A     Probe B                 C (Power)       Leakage (uA)    DA (%)          R parallel (kOhm)
+ *  Inductor        Probe A     Probe B                 L (uH)          R_parasit (Ohm) Q (resonance only)
+ *  Diode           Anode       Cathode                 VdH (mV)        VdL (mV)        I high (mA)     I low (uA)
+ *                                                      n               Is (A)          Rs (Ohm)        Vz (mV)      (Value[4] to [7])
+ *  BJT             Collector   Base        Emitter     Vbe (mV)        Vcb (mV)        Ib (uA)         Beta
+ *  MOSFET          Drain       Gate        Source      Vgs(th) (mV)    Rds(on) (Ohm)   Ciss (pF)       Qg (nC)
+ */
+#define RESULT_MAX_VALUES   8
 
-// Inductor
-class Inductor_Specs
+class Result
 {
   public:
-    float L_Value;    // In uH
-    float R_parasit;  // In Ohms
-    byte ProbeA;      // Connected probes' IDs
-    byte ProbeB;
-};
+    byte Flag;                      // Device flag, see below
+    byte Pins[3];                   // Connected probes' IDs, by role
+    char Power;                     // Unit prefix of Value[0]: 'k', 'u', 'n', 'p' or ' '
+    float Value[RESULT_MAX_VALUES];
+    float Uncertainty;              // Absolute uncertainty of Value[0], 0 if not estimated
+    unsigned int Elapsed;           // Measurement time (ms)
+    byte Socket;                    // Multiplexer socket the part sits on (1...), 0 without multiplexer
+    byte Kind;                      // Refines the flag (KIND_ defines below), 0 if unknown
+    byte Partial;                   // Why some values are cut short or missing (PARTIAL_ defines), 0 if complete
+    byte Agree;                     // Scans agreeing on the identification (robust mode), 0 for a single scan
+    byte Profile;                   // Measurement profile it was taken with (PROFILE_ defines)
 
-// Capacitors
-class Capacitor_Specs
-{
-  public:
-    float C_Value;  // Capacity
-    char Power;     // "u", "n", "p", probably pico ("p") will hardly ever be used
-    byte ProbeA;    // Connected probes' IDs
-    byte ProbeB;
+    void clear(){ memset(this, 0, sizeof(Result)); Power = ' '; }
 };
 
-// Diodes, we may want to include the exponential model
-class Diode_Specs
-{
-  public:
-    float VdH_Value;  // High Current forward voltage drop (mV)
-    float VdL_Value;  // Low  Current forward voltage drop (mV)
-    float HI_Value;   // High test current value (uA)
-    float LI_Value;   // Low test current value (uA)
-    byte Anode;       // Connected probes' IDs
-    byte Cathode;
-};
+// Pin roles
+#define ROLE_A          0
+#define ROLE_B          1
+#define ROLE_ANODE      0
+#define ROLE_CATHODE    1
+#define ROLE_COLLECTOR  0
+#define ROLE_BASE       1
+#define ROLE_EMITTER    2
+#define ROLE_DRAIN      0
+#define ROLE_GATE       1
+#define ROLE_SOURCE     2
 
-//  Semiconductors
-class Semic_Specs
-{
-  public:
-    byte Base;              // Connected probes' IDs
-    byte Collector;
-    byte Emitter;
-    float _V1_;             // Voltage Drop #1 (mV)
-    float _V2_;             // Voltage Drop #2 (mV)
-    float I_B;              // Base Current for BJT (uA)
-    unsigned int Beta;      // Amplification factor (BJT)
-};
+// Value slots
+#define V_RESISTANCE    0
+#define V_CAPACITANCE   0
+#define V_LEAKAGE       1
+#define V_DA            2   // Dielectric absorption
+#define V_R_PARALLEL    3   // Resistor across a capacitor, kOhms (see Charge_Model)
+#define V_INDUCTANCE    0
+#define V_R_PARASIT     1
+#define V_Q             2   // Quality factor, small inductors only
+#define V_VDH           0
+#define V_VDL           1
+#define V_IH            2
+#define V_IL            3
+#define V_N             4   // Ideality factor
+#define V_IS            5   // Saturation current
+#define V_RS            6   // Series resistance
+#define V_VZ            7   // Zener voltage, 0 if not a Zener
+#define V_VBE           0
+#define V_VCB           1
+#define V_IB            2
+#define V_BETA          3
+#define V_VGS_TH        0
+#define V_RDS_ON        1
+#define V_CISS          2
+#define V_QG            3   // Gate charge to MOS_QG_MV
+#define V_CURVE_IB      0   // Curve tracer points (uA, mV, mA, mV, hFE)
+#define V_CURVE_VCE     1
+#define V_CURVE_IC      2
+#define V_CURVE_VBE     3
+#define V_CURVE_HFE     4
+#define V_RNET_A        0   // Star branches of a resistor network, by pin (see RNet_Measure)
+#define V_RNET_W        1
+#define V_RNET_B        2
+#define V_WIPER         3   // Position of a potentiometer wiper, % from the first end
+
+// Kinds:
+#define KIND_UNKNOWN    0
+#define KIND_SILICON    1
+#define KIND_SCHOTTKY   2
+#define KIND_LED        3
+#define KIND_ZENER      4
+#define KIND_POT        5   // Resistor network that is a potentiometer
+#define KIND_GAIN       6   // Curve tracer points (see curve.cpp): gain sweep, active by construction
+#define KIND_ACTIVE     7   // Ic - Vce family, active region
+#define KIND_SATURATED  8   // Ic - Vce family, saturated
+
+// Partial results, worst last (see budget.cpp):
+#define PARTIAL_NONE    0
+#define PARTIAL_SAMPLES 1   // Fewer samples averaged, the values are less precise
+#define PARTIAL_DROPPED 2   // Optional values left out (0)
+#define PARTIAL_TIMEOUT 3   // A phase ran out of time, the identification may be incomplete
+
+// Shunt resistors of a probe (see Shunt_Pin)
+#define SHUNT_L         0
+#define SHUNT_M         1
+#define SHUNT_H         2
+#define SHUNT_NONE      3   // The probe pin itself
+
+// Charge curve models of a pair (see Charge_Model)
+#define CHARGE_CAPACITOR    0   // To be timed
+#define CHARGE_RC           1   // Capacitor with a resistor across it, both measured
+#define CHARGE_RESISTIVE    2   // No capacitor, and too low a resistance for the timing
+#define CHARGE_TIMEOUT      3   // Not discharged afterwards
 
 // Flags:
 #define BJT_FLAG        0b00000010 // 2
@@ -142,20 +203,144 @@ class Semic_Specs
 #define CAPACITOR_FLAG  0b00100000 // 1 << 5 (32)
 #define INDUCTOR_FLAG   0b01000000 // 1 << 6 (64)
 #define RESISTOR_FLAG   0b10000000 // 1 << 7 (128)
+#define RESISTOR_NET_FLAG 0b10000001 // 1 << 7 + 1 (129)
 #define SHORT_CIRCUIT_FLAG 0b00001111  // 15
 #define OPEN_CIRCUIT_FLAG  0b11110000  // 240        
 
+// Command replies that are not measurements (see command.cpp):
+#define CURVE_FLAG         0b11111011  // 251
+#define NETWORK_FLAG       0b11111100  // 252
+#define REPLY_ERROR_FLAG   0b11111101  // 253
+#define CALIBRATION_FLAG   0b11111110  // 254
+#define REPLY_OK_FLAG      0b11111111  // 255
+
+// Output modes:
+#define TEXT_MODE       0 // Human readable report
+#define BINARY_MODE     1 // COBS framed result messages, see protocol.cpp
+
+// Result frame layout
+#define RESULT_VERSION      8
+#define RESULT_HEADER       20 // Bytes before the values
+
+// Interrupt driven USART0 link, replaces the Arduino "Serial" object.
+class Serial_Link : public Stream
+{
+  public:
+    void begin(unsigned long baud);
+    int available();
+    int peek();
+    int read();
+    size_t write(uint8_t c);
+    int availableForWrite();
+    void flush();
+    using Print::write; // Keeps the buffer and string versions of write()
+};
+
+extern Serial_Link Link;
+
+// Die temperature and the scales it gives the calibrated values, sampled once per measure (see temperature.cpp)
+class Thermal_State
+{
+  public:
+    float Celsius;
+    float Shunt;        // Shunt resistors, against their value at TEMP_CAL_C
+    float Pin_R;        // Internal resistances of the pins
+    float Bandgap;      // Bandgap reference
+};
+
+/*
+ * Measurement profile: the sample counts and settling times shared by all the routines, so one firmware sorts
+ * parts quickly or characterises them (see profile.cpp, the values are in PROFILE_TABLE).
+ */
+class Measure_Profile
+{
+  public:
+    byte Id;            // PROFILE_ defines
+    byte Samples;       // Readings averaged per resistance value
+    byte Pair_Samples;  // Readings of each node in the BJT gain and drain/source tests, 64 at most
+    byte Oversample;    // Readings per diode voltage, 64 at most
+    byte Mos_Repeats;   // Gate ramps averaged for the MOSFET threshold
+    byte Settle_ms;     // Settling time of each scan step
+};
+
+// Profiles, 0 if a result does not say (see PROFILE_TABLE)
+#define PROFILE_FAST        1
+#define PROFILE_BALANCED    2
+#define PROFILE_PRECISE     3
+#define PROFILE_CUSTOM      4   // A selected one with some value changed (samples command)
+#define PROFILE_COUNT       3   // Selectable ones
+
 // Attributes, Global Variables to be modified within functions
 namespace attr
 {
-  extern Resistor_Specs    Resistor;
-  extern Capacitor_Specs   Capacitor;
-  extern Inductor_Specs    Inductor;
-  extern Diode_Specs       Diode;
-  extern Semic_Specs       Semiconductor;
+  extern byte              Output_Mode;   // TEXT_MODE or BINARY_MODE
+  extern Measure_Profile   Profile;       // Sample counts and settling times in use
+  extern unsigned int      Budget;        // Time an identification may take (ms), 0 for no limit
+  extern byte              Consensus;     // Scans that must agree on an identification, 0 for a single scan
+  extern Thermal_State     Thermal;       // Die temperature of the last measure
   //extern bool Use_Rh;
 }
 
+inline float Probe::Rl_val() const { return Rl_cal * attr::Thermal.Shunt; }
+inline float Probe::Rm_val() const { return Rm_cal * attr::Thermal.Shunt; }
+inline float Probe::Rh_val() const { return Rh_cal * attr::Thermal.Shunt; }
+
+// Calibrated references at the temperature of the measure (see temperature.cpp)
+#define INTERNAL_R_LOW  (INTERNAL_R_LOW_CAL * attr::Thermal.Pin_R)
+#define INTERNAL_R_HIGH (INTERNAL_R_HIGH_CAL * attr::Thermal.Pin_R)
+#define BANDGAP_V       (BANDGAP_V_CAL * attr::Thermal.Bandgap)
+#define THERMAL_VOLTAGE (8.617333e-5 * (attr::Thermal.Celsius + 273.15))  // kT/q (V)
+
 extern const Probe P1;
 extern const Probe P2;
-extern const Probe P3;
\ No newline at end of file
+extern const Probe P3;
+
+// Probe table, in board order (defined next to the probes in Main.ino). Measurements reach the probes through it.
+extern const Probe *const Probes[];
+
+/*
+ * Role map: which probe of the table plays each role of a device (ROLE_ defines above).
+ * next() steps through every assignment of "Roles" roles to distinct probes, so a measurement is written
+ * once for a role map and simply repeated for each orientation of the device:
+ *
+ *  Role_Map BJT(3);
+ *  do { ... BJT[ROLE_BASE].Rm ... } while(BJT.next());
+ */
+#define ROLE_MAX 3
+
+class Role_Map
+{
+  public:
+    byte Roles;             // Number of roles assigned
+    byte Index[ROLE_MAX];   // Probe table index of each role
+
+    Role_Map(byte roles) : Roles(roles) { for(byte r = 0; r < ROLE_MAX; r++){ Index[r] = r; } }
+
+    const Probe &operator[](byte role) const { return *Probes[Index[role]]; }
+    bool next(); // Next assignment, 0 once all have been visited (see measure.cpp)
+};
+
+// Hardware hooks of the socket multiplexer (see mux.cpp), replaceable to run the sequencer on a simulated bank
+class Mux_Hooks
+{
+  public:
+    void (*select)(byte socket);    // Routes the probes to a socket, 0 disconnects them all
+    byte (*measure)(Result &DUT);   // Identifies the part on the selected socket
+    unsigned long (*now)();         // Time base (ms)
+};
+
+extern Mux_Hooks Mux;
+
+// Drive state scan of the probes (see scan.cpp)
+#define SCAN_MAX_PROBES 8
+
+class Scan
+{
+  public:
+    byte Count;                                 // Probes scanned
+    unsigned int Signature[SCAN_MAX_PROBES];    // Readings of each probe, bit s set if HIGH in state s
+    byte Link[SCAN_MAX_PROBES];                 // Bit b set if driving probe a alone lifts probe b (current a -> b)
+
+    bool reads(byte p, byte mask) const;
+    unsigned int changes() const;
+};
\ No newline at end of file
@@ -6,14 +6,146 @@
 
 #define __AVR_ATmega328PB__ //The ATMEL microcontroller model (see avr/io.h)
 
-// Defining internal resistances of the Board in Ohms
-#define INTERNAL_R_LOW 22
-#define INTERNAL_R_HIGH 30
+#define PROBE_COUNT 3 // Entries of the probe table (see Main.ino), SCAN_MAX_PROBES at most
 
+// Defining internal resistances of the Board in Ohms, at TEMP_CAL_C (INTERNAL_R_LOW/HIGH are scaled to the temperature)
+#define INTERNAL_R_LOW_CAL 22
+#define INTERNAL_R_HIGH_CAL 30
+#define BANDGAP_V_CAL 1.1           // Internal reference (V), BANDGAP_V at the temperature
 
-// Constant Global Variables
-const bool diode_C1anode[8] = {0,1,0,1,0,1,0,0};
-const bool diode_C2anode[8] = {0,0,1,1,0,0,1,0};
+// Temperature compensation (see temperature.cpp)
+#define TEMP_CAL_C 25               // Temperature the probes and the references above were calibrated at
+#define TEMP_25C_LSB 292            // Sensor reading at 25 C (1.1 V reference), per chip: +-10 C uncalibrated
+#define TEMP_LSB_PER_C 0.93
+#define TEMP_SAMPLES 8
+#define TEMP_SETTLE_MS 5            // Of the reference on AREF, each way
+#define TEMP_INTERVAL_MS 10000      // Age of a sample before a measure takes a new one
+#define SHUNT_TC_PPM 100            // Temperature coefficients (ppm/C)
+#define PIN_R_TC_PPM 4000
+#define BANDGAP_TC_PPM 50
+#define DIODE_TC_MV -2.0            // Forward drops and Vbe (mV/C)
+#define DIODE_EG 1.11               // Band gap (eV) and exponent of T in the saturation current (silicon)
+#define DIODE_XTI 3
+#define BETA_XTB 1.5                // Exponent of T in the gain of a BJT
+#define VGS_TH_TC_MV -3.0           // MOSFET threshold (mV/C)
+#define RDS_ON_EXP 2.3              // Exponent of T in Rds(on)
 
-const bool C3unused[8] = {0,0,0,0,1,1,1,0}; // Specific for C3
-const bool C1C2shortcircuit[8] = {0,1,1,1,0,1,1,0};
+// Serial link (see protocol.cpp)
+#define LINK_BAUD 500000            // Exact with the 16 MHz clock in double speed mode
+#define TX_BUFFER_SIZE 128          // Must be a power of 2, no larger than 256
+#define RX_BUFFER_SIZE 64           // Must be a power of 2, no larger than 256
+#define DEFAULT_OUTPUT_MODE TEXT_MODE
+
+// Serial commands (see command.cpp)
+#define CMD_LINE_LENGTH 48
+#define CMD_MAX_ARGS 8
+
+// Measurement profiles (see profile.cpp), selected with the profile command or a long press of the button
+#define DEFAULT_PROFILE PROFILE_BALANCED
+#define LONG_PRESS_MS 1000
+#define PROFILE_TABLE { \
+/*  Id                  Samples Pair_Samples Oversample Mos_Repeats Settle_ms */ \
+  { PROFILE_FAST,       20,     16,          4,         3,          5  }, \
+  { PROFILE_BALANCED,   100,    50,          16,        10,         10 }, \
+  { PROFILE_PRECISE,    250,    64,          64,        20,         20 }, \
+}
+
+// Time budget of an identification and the limits of its phases (see budget.cpp)
+#define DEFAULT_BUDGET_MS 8000
+#define DISCHARGE_TIMEOUT_MS 10000
+#define CAP_TIMEOUT_MS 2000         // CapacitorTMeasure
+#define IND_TIMEOUT_MS 655          // InductorTMeasure
+#define MOS_OPTIONAL_MS 300         // Left over needed for Rds(on), Ciss and Qg
+
+// Robust identification (see Scan_Vote)
+#define DEFAULT_CONSENSUS 0         // Scans that must agree on the signatures, 0 for a single scan
+#define CONSENSUS_MAX_SCANS 5
+
+// Resistance ranging (see Resistance_Auto)
+#define RES_NOISE_LSB 0.5           // ADC noise per reading (rms)
+#define RES_LEAKAGE_NA 50           // Input leakage of a pin, through the node impedance
+#define RES_INTERNAL_TOL 5          // Uncertainty of the internal resistances, when taken into account (Ohms)
+#define RES_SHUNT_TOL 0.01          // Of the calibrated shunt values (relative)
+
+// Socket multiplexer (see mux.cpp)
+#define MUX_SOCKETS 8               // 2^MUX_SELECT_BITS at most
+#define MUX_SELECT_BITS 3
+#define MUX_INHIBIT_PIN 19          // A5, HIGH opens every switch
+#define MUX_SWITCH_MS 1             // Settling after a switch
+#define MUX_BLEED_R 10000           // Discharge resistor from each socket pin to GND while deselected (Ohms)
+#define MUX_SELECT_PINS {2, 3, 18}  // Spare pins: D2, D3, A4, least significant bit first
+
+// Diode sweep (see Diode_Sweep)
+#define DIODE_SETTLE_MS 5
+#define DIODE_MIN_I 5e-8            // Smallest current taken into the fit (A)
+#define LED_MIN_V 1.4               // Drops at 1 mA telling the kinds apart (V)
+#define SCHOTTKY_MAX_V 0.45
+#define ZENER_MAX_MV 4500           // Reverse drop below which a diode is taken for a Zener
+#define ZENER_ASYMMETRY_MV 300      // Drop difference between both ways telling a Zener from a resistor
+
+// Resistor networks and potentiometers (see RNet_Measure)
+#define RNET_SETTLE_MS 5
+#define RNET_WIPER_RATIO 0.05       // Largest wiper branch against the track, for a potentiometer
+
+// MOSFET threshold (see MOS_Measure)
+#define MOS_TIMEOUT_MS 200          // Longest gate ramp, a drain not switching by then never will
+#define MOS_MIN_RAMP_US 500         // Shortest ramp to the threshold, keeps the capture delay below 1% of Vgs
+#define MOS_DEADLINE_FACTOR 4       // Deadline of a ramp against its expected time
+#define MOS_QG_MV 4500              // Gate drive the gate charge is given at
+
+// Inductor single pulse fit (see Inductance_Fit)
+#define RL_SAMPLES 48               // Samples of the current rise
+#define RL_SPAN_TAU 5               // Time constants they cover
+#define RL_MIN_PERIOD_US 16         // Fastest auto triggered conversions (1 MHz ADC clock)
+#define RL_HIGH_CURRENT_MAX_R 30    // DC resistance below which inductors are timed without shunt (see isRL)
+
+// Small inductors, rung against a reference capacitor (see ResonanceTMeasure)
+#define LC_REF_PIN 0                // Gate of the switch (N-MOSFET to GND, HIGH on) putting the capacitor on LC_PROBE, 0 if not fitted
+#define LC_REF_PF 4700.0
+#define LC_PROBE 0                  // Probe whose Rm pin is AIN0 (D6), P1
+#define LC_LOOP_R 30                // Ringing loop resistance besides the coil: switch and pin of the other probe (Ohms)
+#define LC_COMPARATOR_MV 5          // Amplitude below which the comparator misses the crossings
+#define LC_MAX_EDGES 32             // Crossings timestamped, more are only counted
+#define LC_GAP_TICKS 16000          // 1 ms without a crossing ends the ringing
+
+// Small capacitors through Rh (see Small_Capacitance)
+#define SMALLCAP_BUDGET_US 2000     // Charge cycles per way round are repeated within this time
+#define SMALLCAP_MAX_CYCLES 64
+#define SMALLCAP_MIN_PF 5           // Smallest capacitor told from the stray capacitance
+#define SMALLCAP_MAX_PF 10000       // Larger ones are timed through Rm (CapacitorTMeasure)
+#define SMALLCAP_MATCH_PCT 20       // Agreement of both ways round
+#define EEPROM_STRAY 0              // EEPROM address of the stray capacitances (PROBE_COUNT^2 floats)
+
+// Capacitor leakage and dielectric absorption (see Capacitor_Leakage)
+#define LEAK_WINDOW_MS 10000        // Longest leakage test, unless the command gives another
+#define LEAK_SAMPLE_MS 20
+#define LEAK_STEP_MS 1000           // Between the estimates compared for the early exit
+#define LEAK_STABLE_PCT 5
+#define LEAK_FLOOR_UA 0.005         // Estimates closer than this agree whatever their ratio
+#define LEAK_MAX_DROP_MV 2500       // Drop across Rh above which the hold moves to Rm
+#define LEAK_MIN_MV 1000            // Charge below which the part is not taken for a capacitor
+#define DA_SHORT_MS 1000
+#define DA_RECOVERY_MS 5000
+#define DA_SAMPLE_MS 50
+
+// BJT curve tracer (see curve.cpp)
+#define CURVE_SAMPLES 32            // Rounds of readings of the three nodes per point
+#define CURVE_SETTLE_MS 5           // Per point, Rh against the node capacitances settles in well under 1 ms
+#define CURVE_MIN_DROP_MV 25        // Base shunt drop below which no hFE is given
+
+// Live meter (see meter.cpp)
+#define METER_WINDOW_MS 20          // Time budget of a resistance reading
+#define METER_EMA_ALPHA 0.25        // Weight of a new reading in the moving average
+#define METER_STEP 0.1              // Relative change taken as a new value rather than noise, the average restarts
+#define METER_DEADBAND 0.002        // Relative change of the average reported as an update
+#define METER_MAX_MISSES 10         // Failed readings in a row taken as the part removed
+
+#define RETENTION_CHARGE_MS 10      // Charge time of the capacitor pair test (see identify.cpp)
+#define RETENTION_FULL_LSB 1000     // Voltage across the pair taken as the rail, the charge stops there
+#define RETENTION_RISE_LSB 4        // Rise across the pair while charging taken as a capacitor, 1 mF gains ~7
+#define RETENTION_WAIT_US 200       // Bleed time through Rh before reading, floating probes are empty by then
+#define RETENTION_THRESHOLD 10      // ADC reading above which a pair held its charge
+#define CAP_MODEL_T0_US 100         // First reading of the charge curve, the next ones at double the time
+#define CAP_MODEL_SAMPLES 13        // The last one at ~400 ms
+#define CAP_MODEL_NOISE_LSB 2       // Changes taken for noise
+#define CAP_MODEL_SETTLE_TAU 5      // Time constants for the charge curve to settle within the noise
@@ -0,0 +1,143 @@
+#define CURVE_CPP
+
+#include "common.h"
+#include "config.h"
+#include "functions.h"
+
+/*
+ * BJT curve tracer, for matching transistors: hFE over the collector current, and Ic against Vce for a family of
+ * base currents into saturation.
+ *
+ * The nodes are fed with DC through their probe shunts, so every point is a true operating point of the transistor.
+ * (The timer PWM cannot be used on the shunts: the probe nodes have no filter capacitor, which would load every
+ * other measure, and unfiltered the transistor switches between on, off and saturation, the averages then not lying
+ * on its characteristic.) Two sweeps, each from the shunts:
+ *
+ *  Gain        Collector straight to the rail, base through Rh or Rm and emitter through Rl, Rm or Rh. The emitter
+ *              shunt sets the current (about 6 uA, 200 uA and 1 to 6 mA) and the base stays below the collector,
+ *              so all of these are in the active region: hFE over three decades of Ic. Ic = Ie - Ib.
+ *  Family      Emitter straight to the rail, base through Rh, Rm and Rl (some uA, some hundred uA, some mA) and
+ *              the collector load through Rl, Rm and Rh for each. With the loads limiting Ic to about 7 mA,
+ *              0.23 mA and 7 uA most of these points are saturated: they show how deep, and at which Vce.
+ *
+ * Points are reported with their kind: KIND_GAIN for the gain sweep, KIND_ACTIVE or KIND_SATURATED (Vce below Vbe,
+ * the collector junction forward) for the family. Every current goes through a shunt, so no pin carries more than
+ * about 15 mA. hFE is left 0 where the base drop is below CURVE_MIN_DROP_MV, Ib being lost in the noise.
+ *
+ * After CURVE_SETTLE_MS (many time constants of the shunts against the node capacitances) the three nodes are
+ * read in turn (interleaved) over CURVE_SAMPLES rounds, and the currents follow from the drops across the shunts.
+ * PNP transistors use the same steps mirrored: shunts and pins swap rails.
+ * Every point is reported as soon as it is measured, so the host can plot while the sweep goes on.
+ */
+
+// Mean node voltages (mV) of collector, base and emitter, read in turn over CURVE_SAMPLES rounds.
+static void sample_nodes(const Probe *Pins[3], float V[3])
+{
+    unsigned long sum[3] = {0, 0, 0};
+
+    for(byte r = 0; r < 3; r++){ analogRead(Pins[r]->ID); } // Discarding the first measures after switching
+    for(byte i = 0; i < CURVE_SAMPLES; i++)
+    {
+        for(byte r = 0; r < 3; r++){ sum[r] += analogRead(Pins[r]->ID); }
+    }
+    for(byte r = 0; r < 3; r++){ V[r] = sum[r] * 5000.0 / (1023.0 * CURVE_SAMPLES); }
+}
+
+// Drives a shunt (or the pin itself, SHUNT_NONE) of a probe to a level. Returns the pin, its resistance in *R.
+static byte drive(const Probe &P, byte Size, bool level, float *R)
+{
+    byte Pin = Shunt_Pin(P, Size, R);
+    pinMode(Pin, OUTPUT);
+    digitalWrite(Pin, level);
+    return Pin;
+}
+
+static void release(byte Pin)
+{
+    digitalWrite(Pin, LOW);
+    pinMode(Pin, INPUT);
+}
+
+/*
+ * Traces the transistor of an identification result (NPN_FLAG or PNP_FLAG, pins by role), reporting each point
+ * as a CURVE_FLAG result: Ib (uA), Vce (mV), Ic (mA), Vbe (mV) and hFE, with its kind. Returns the number of
+ * points, 0 if the result is not a transistor.
+ */
+byte Curve_Trace(byte request, const Result &BJT, void (*report)(byte request, const Result &DUT))
+{
+    static const byte Ib_Steps[] = { SHUNT_H, SHUNT_M, SHUNT_L };
+    static const byte Load_Steps[] = { SHUNT_L, SHUNT_M, SHUNT_H };
+    static const byte Ie_Steps[] = { SHUNT_H, SHUNT_M, SHUNT_L };
+
+    if(BJT.Flag != NPN_FLAG && BJT.Flag != PNP_FLAG){ return 0; }
+    bool PNP = (BJT.Flag == PNP_FLAG);
+
+    const Probe *Pins[3];
+    for(byte r = 0; r < 3; r++)
+    {
+        Pins[r] = Probe_By_ID(BJT.Pins[r]);
+        if(!Pins[r]){ return 0; }
+        pinMode(Pins[r]->ID, INPUT);
+    }
+    const Probe &C = *Pins[ROLE_COLLECTOR];
+    const Probe &B = *Pins[ROLE_BASE];
+    const Probe &E = *Pins[ROLE_EMITTER];
+
+    const bool Src = !PNP;  // Level feeding base and collector, the emitter goes to the other one
+    const float R_src = PNP ? INTERNAL_R_LOW : INTERNAL_R_HIGH; // Of the pins at each level
+    const float R_snk = PNP ? INTERNAL_R_HIGH : INTERNAL_R_LOW;
+    const float V_src = PNP ? 0 : 5000;                         // mV
+    const float sign = PNP ? -1 : 1;
+
+    Result Point;
+    Point.clear();
+    Point.Flag = CURVE_FLAG;
+    memcpy(Point.Pins, BJT.Pins, 3);
+    Point.Socket = BJT.Socket;
+
+    byte points = 0;
+    for(byte sweep = 0; sweep < 2; sweep++)
+    {
+        bool Gain = (sweep == 0);
+        float R_none = 0;
+        byte Rail_Pin = Gain ? drive(C, SHUNT_NONE, Src, &R_none) : drive(E, SHUNT_NONE, !Src, &R_none);
+
+        for(byte i = 0; i < (Gain ? 2 : sizeof(Ib_Steps)); i++) // Through Rl the base drop of the gain sweep is noise
+        {
+            float Rb = 0;
+            byte Base_Pin = drive(B, Ib_Steps[i], Src, &Rb);
+
+            for(byte v = 0; v < 3; v++)
+            {
+                float R = 0; // Emitter shunt in the gain sweep, collector load in the family
+                byte Pin = Gain ? drive(E, Ie_Steps[v], !Src, &R) : drive(C, Load_Steps[v], Src, &R);
+                delay(CURVE_SETTLE_MS);
+
+                float V[3];
+                sample_nodes(Pins, V);
+                release(Pin); // Off until the next step
+
+                float Ib = sign * (V_src - V[ROLE_BASE]) / (Rb + R_src); // mV / Ohms = mA
+                float Ic = Gain ? sign * (V[ROLE_EMITTER] - (5000 - V_src)) / (R + R_snk) - Ib
+                                : sign * (V_src - V[ROLE_COLLECTOR]) / (R + R_src);
+
+                Point.Value[V_CURVE_IB]  = Ib * 1000; // uA
+                Point.Value[V_CURVE_VCE] = sign * (V[ROLE_COLLECTOR] - V[ROLE_EMITTER]);
+                Point.Value[V_CURVE_IC]  = Ic;
+                Point.Value[V_CURVE_VBE] = sign * (V[ROLE_BASE] - V[ROLE_EMITTER]);
+                Point.Value[V_CURVE_HFE] = (Ib * Rb > CURVE_MIN_DROP_MV) ? Ic / Ib : 0;
+
+                bool Saturated = (Point.Value[V_CURVE_VCE] < Point.Value[V_CURVE_VBE]);
+                Point.Kind = Gain ? KIND_GAIN : Saturated ? KIND_SATURATED : KIND_ACTIVE;
+
+                report(request, Point);
+                points ++;
+            }
+            release(Base_Pin);
+        }
+        release(Rail_Pin);
+    }
+    return points;
+}
+
+#undef CURVE_CPP
@@ -22,99 +22,255 @@ char toHuman(byte numProbe)
     break;
   }
 }
-// We will overload our function for all the devices we have:
-byte display(Resistor_Specs DUT, byte dut_flag)
+
+/*
+ * Message catalog. Every plain string literal is copied from flash into the 2 KB of SRAM at startup,
+ * so all the report text is kept in flash (PROGMEM) and read from there while printing.
+ *
+ * Each device has a title and a body template, the transistors of each family share the same body.
+ * Templates are plain text with the following fields taken from the result record:
+ *
+ *  %vd     Value[v] printed with d decimals
+ *  %Ev     Value[v] in scientific notation
+ *  %P      Unit prefix (Power)
+ *  %Rk     Probe of role k, as its colour (see toHuman)
+ *  %Nk     Probe ID of role k
+ *  %?v     Skips the rest of the line if Value[v] is 0 (not measured)
+ *  %Ud     " +- " and the uncertainty of Value[0] with d decimals, nothing if not estimated
+ *  %%      A percent sign
+ */
+const char Msg_Device[]        PROGMEM = "DEVICE: ";
+const char Msg_Error[]         PROGMEM = "MEASUREMENT ERROR";
+
+// Kind names, printed before the title (indexed by the KIND_ defines)
+const char Kind_Silicon[]      PROGMEM = "Silicon ";
+const char Kind_Schottky[]     PROGMEM = "Schottky ";
+const char Kind_LED[]          PROGMEM = "LED ";
+const char Kind_Zener[]        PROGMEM = "Zener ";
+const char Kind_Pot[]          PROGMEM = "Potentiometer, ";
+const char Kind_Gain[]         PROGMEM = "Gain: ";
+const char Kind_Active[]       PROGMEM = "Active: ";
+const char Kind_Saturated[]    PROGMEM = "Saturated: ";
+
+const char *const Kind_Names[] PROGMEM = { 0, Kind_Silicon, Kind_Schottky, Kind_LED, Kind_Zener, Kind_Pot,
+                                         Kind_Gain, Kind_Active, Kind_Saturated };
+
+// Partial results, after the body (indexed by the PARTIAL_ defines)
+const char Partial_Samples[]   PROGMEM = "(Time budget: fewer samples averaged)";
+const char Partial_Dropped[]   PROGMEM = "(Time budget: optional values left out)";
+const char Partial_Timeout[]   PROGMEM = "(Time budget: ran out, the result may be incomplete)";
+
+const char *const Partial_Names[] PROGMEM = { 0, Partial_Samples, Partial_Dropped, Partial_Timeout };
+
+const char Msg_Agree[]         PROGMEM = "Scans agreeing: ";
+const char Msg_Profile[]       PROGMEM = "Profile: ";
+
+// Profile names (indexed by the PROFILE_ defines)
+const char Profile_Fast[]      PROGMEM = "fast";
+const char Profile_Balanced[]  PROGMEM = "balanced";
+const char Profile_Precise[]   PROGMEM = "precise";
+const char Profile_Custom[]    PROGMEM = "custom";
+
+const char *const Profile_Names[] PROGMEM = { 0, Profile_Fast, Profile_Balanced, Profile_Precise, Profile_Custom };
+
+const char Title_BJT[]         PROGMEM = "Unidentified BJT ";
+const char Title_MOS[]         PROGMEM = "Unidentified MOS ";
+const char Title_NPN[]         PROGMEM = "BJT NPN Transistor ";
+const char Title_PNP[]         PROGMEM = "BJT PNP Transistor ";
+const char Title_NMOS_ENH[]    PROGMEM = "Enhancement NMOS Transistor ";
+const char Title_NMOS_DEP[]    PROGMEM = "Depletion NMOS Transistor ";
+const char Title_PMOS_ENH[]    PROGMEM = "Enhancement PMOS Transistor ";
+const char Title_PMOS_DEP[]    PROGMEM = "Depletion PMOS Transistor ";
+const char Title_Diode[]       PROGMEM = "Diode ";
+const char Title_Capacitor[]   PROGMEM = "Capacitor "; // Messes up Big Capacitors with inductors?? // Does not detect very small ones
+const char Title_Inductor[]    PROGMEM = "Inductor ";
+const char Title_Resistor[]    PROGMEM = "Resistor ";
+const char Title_RNet[]        PROGMEM = "Resistor Network ";
+const char Title_Short[]       PROGMEM = "Shorted Probes ";
+const char Title_Open[]        PROGMEM = "Open Circuit";
+
+const char Body_Resistor[]     PROGMEM = "R = %01%U1 %POhms\n";
+const char Body_RNet[]         PROGMEM = "Branches: %R0 = %01 %POhms    %R1 = %11 %POhms    %R2 = %21 %POhms\n"
+                                         "%?3Wiper %R1 at %31 %% of the track from %R0\n";
+const char Body_Capacitor[]    PROGMEM = "C = %02 %PF\n"
+                                         "%?1Leakage = %13 uA    DA = %21 %%\n"
+                                         "%?3Parallel R = %32 kOhms\n";
+const char Body_Inductor[]     PROGMEM = "L = %01 uH\n"
+                                         "R_parasit = %12 Ohms\n"
+                                         "%?2Q = %21\n";
+const char Body_Diode[]        PROGMEM = "High Current forward voltage drop = %00 mV, Test Intensity: %22 mA\n"
+                                         "Low Current forward voltage drop = %10 mV, Test Intensity: %32 uA\n"
+                                         "Ideality factor n = %42, Is = %E5 A, Rs = %61 Ohms\n"
+                                         "Zener voltage = %70 mV (0 if none)\n"
+                                         "Anode pin: %N0\n"
+                                         "Cathode pin: %N1\n";
+const char Body_BJT[]          PROGMEM = "Collector probe = %R0    Base probe = %R1    Emitter probe = %R2\n"
+                                         "Vbe = %02 mV \n"
+                                         // "Vcb = %12 mV \n"
+                                         "Base Current = %22 uA\n"
+                                         "Amplification factor = %30\n";
+const char Body_MOS[]          PROGMEM = "Gate probe = %R1    Drain probe = %R0    Source probe = %R2\n"
+                                         "Threshold Vgs = %00 mV \n"
+                                         "ON State Rds = %12 Ohms \n"
+                                         "Ciss = %20 pF    Qg = %32 nC\n";
+const char Body_Curve[]        PROGMEM = "Ib = %02 uA    Vce = %10 mV    Ic = %22 mA    Vbe = %30 mV    hFE = %40\n";
+
+class Message
+{
+  public:
+    byte Flag;
+    PGM_P Title;    // 0 for the replies that are not a device
+    PGM_P Body;     // Template, 0 if the title says it all
+};
+
+const Message Catalog[] PROGMEM =
+{
+  { BJT_FLAG,           Title_BJT,          0 },
+  { MOS_FLAG,           Title_MOS,          0 },
+  { NPN_FLAG,           Title_NPN,          Body_BJT },
+  { PNP_FLAG,           Title_PNP,          Body_BJT },
+  { NMOS_ENH_FLAG,      Title_NMOS_ENH,     Body_MOS },
+  { NMOS_DEP_FLAG,      Title_NMOS_DEP,     Body_MOS },
+  { PMOS_ENH_FLAG,      Title_PMOS_ENH,     Body_MOS },
+  { PMOS_DEP_FLAG,      Title_PMOS_DEP,     Body_MOS },
+  { DIODE_AC_FLAG,      Title_Diode,        Body_Diode },
+  { DIODE_CA_FLAG,      Title_Diode,        Body_Diode },
+  { CAPACITOR_FLAG,     Title_Capacitor,    Body_Capacitor },
+  { INDUCTOR_FLAG,      Title_Inductor,     Body_Inductor },
+  { RESISTOR_FLAG,      Title_Resistor,     Body_Resistor },
+  { RESISTOR_NET_FLAG,  Title_RNet,         Body_RNet },
+  { SHORT_CIRCUIT_FLAG, Title_Short,        0 },
+  { OPEN_CIRCUIT_FLAG,  Title_Open,         0 },
+  { CURVE_FLAG,         0,                  Body_Curve },
+};
+
+// Prints a flash string, new lines are sent as CR LF like println() does.
+static void print_P(PGM_P text)
 {
-  Serial.println("DEVICE: Resistor ");
-  Serial.print("R = "); Serial.print(attr::Resistor.R_Value,1); 
-  Serial.print(" "); Serial.print(attr::Resistor.Power); Serial.println("Ohms");
+  char c;
+  while((c = pgm_read_byte(text++)))
+  {
+    if(c == '\n'){ Link.println(); }
+    else         { Link.write(c); }
+  }
 }
-byte display(Capacitor_Specs DUT, byte dut_flag)
+
+// Prints a value as mantissa and power of ten, for quantities spanning many decades.
+static void print_scientific(float x)
 {
-  Serial.println("DEVICE: Capacitor "); // Messes up Big Capacitors with inductors?? // Does not detect very small ones
-  Serial.print("C = "); Serial.print(attr::Capacitor.C_Value,2); 
-  Serial.print(" "); Serial.print(attr::Capacitor.Power); Serial.println("F");
+  int exponent = (x == 0) ? 0 : floor(log10(fabs(x)));
+
+  Link.print(x / pow(10, exponent), 2);
+  Link.print('e');
+  Link.print(exponent);
 }
-byte display(Inductor_Specs DUT, byte dut_flag)
+
+// Prints a template (see the catalog above), filling in the fields from the result.
+static void print_template(PGM_P text, const Result &DUT)
 {
-  Serial.println("DEVICE: Inductor ");
-  Serial.print("L = "); Serial.print(attr::Inductor.L_Value,0); 
-  Serial.print(" "); Serial.println("uH");
-  Serial.print("R_parasit = "); Serial.print(attr::Inductor.R_parasit);
-  Serial.print(" "); Serial.println("Ohms");
+  char c;
+  while((c = pgm_read_byte(text++)))
+  {
+    if(c == '\n'){ Link.println(); continue; }
+    if(c != '%') { Link.write(c); continue; }
+
+    char field = pgm_read_byte(text++);
+    if(field == 'P')
+    {
+      Link.print(DUT.Power);
+      continue;
+    }
+    if(field == '%')
+    {
+      Link.write('%');
+      continue;
+    }
+
+    byte arg = pgm_read_byte(text++) - '0';
+    if(field == 'U')
+    {
+      if(DUT.Uncertainty)
+      {
+        Link.print(F(" +- "));
+        Link.print(DUT.Uncertainty, arg);
+      }
+      continue;
+    }
+    if(field == '?') // Optional line, only printed if the value is measured (not 0)
+    {
+      if(!DUT.Value[arg])
+      {
+        while((c = pgm_read_byte(text)) && c != '\n'){ text++; }
+        if(c){ text++; }
+      }
+      continue;
+    }
+    if(field == 'E')
+    {
+      print_scientific(DUT.Value[arg]);
+    }
+    else if(field == 'R')
+    {
+      Link.print(toHuman(DUT.Pins[arg]));
+    }
+    else if(field == 'N')
+    {
+      Link.print(DUT.Pins[arg]);
+    }
+    else if(field >= '0' && field < '0' + RESULT_MAX_VALUES)
+    {
+      Link.print(DUT.Value[field - '0'], arg);
+    }
+  }
 }
-byte display(Diode_Specs DUT, byte dut_flag)
+
+// "Profile: <name>" line, nothing for an unknown profile.
+void display_profile( byte id )
 {
-  Serial.println("DEVICE: Diode ");
-  Serial.print("High Current forward voltage drop = "); Serial.print(attr::Diode.VdH_Value,0);
-  Serial.print(" mV, Test Intensity: "); Serial.print(attr::Diode.HI_Value); Serial.println(" mA");
-  Serial.print("Low Current forward voltage drop = "); Serial.print(attr::Diode.VdL_Value,0);
-  Serial.print(" mV, Test Intensity: "); Serial.print(attr::Diode.LI_Value); Serial.println(" uA");
-  Serial.print("Anode pin: "); Serial.println(attr::Diode.Anode);
-  Serial.print("Cathode pin: "); Serial.println(attr::Diode.Cathode);
+  if(!id || id >= sizeof(Profile_Names)/sizeof(Profile_Names[0])){ return; }
+
+  print_P(Msg_Profile);
+  print_P((PGM_P) pgm_read_ptr(&Profile_Names[id]));
+  Link.println();
 }
-byte display(Semic_Specs DUT, byte dut_flag)
+
+// Human readable report of a result, by device flag.
+void display( const Result &DUT )
 {
-  switch (dut_flag)
+  for(byte i = 0; i < sizeof(Catalog)/sizeof(Message); i++)
   {
-    case NPN_FLAG: // 4
-      Serial.println("DEVICE: BJT NPN Transistor ");
-      Serial.print("Collector probe = "); Serial.print(toHuman(attr::Semiconductor.Collector)); Serial.print("    ");
-      Serial.print("Base probe = "); Serial.print(toHuman(attr::Semiconductor.Base)); Serial.print("    ");
-      Serial.print("Emitter probe = "); Serial.println(toHuman(attr::Semiconductor.Emitter)); 
-      Serial.print("Vbe = "); Serial.print(attr::Semiconductor._V1_); Serial.println(" mV ");
-      // Serial.print("Vcb = "); Serial.print(attr::Semiconductor._V2_); Serial.println(" mV ");
-      Serial.print("Base Current = "); Serial.print(attr::Semiconductor.I_B); Serial.print(" "); Serial.println("uA");
-      Serial.print("Amplification factor = "); Serial.println(attr::Semiconductor.Beta);
-      break; 
-
-    case PNP_FLAG: // 5
-      Serial.println("DEVICE: BJT PNP Transistor ");
-      Serial.print("Collector probe = "); Serial.print(toHuman(attr::Semiconductor.Collector)); Serial.print("    ");
-      Serial.print("Base probe = "); Serial.print(toHuman(attr::Semiconductor.Base)); Serial.print("    ");
-      Serial.print("Emitter probe = "); Serial.println(toHuman(attr::Semiconductor.Emitter)); 
-      Serial.print("Vbe = "); Serial.print(attr::Semiconductor._V1_); Serial.println(" mV ");
-      // Serial.print("Vcb = "); Serial.print(attr::Semiconductor._V2_); Serial.println(" mV ");
-      Serial.print("Base Current = "); Serial.print(attr::Semiconductor.I_B); Serial.print(" "); Serial.println("uA");
-      Serial.print("Amplification factor = "); Serial.println(attr::Semiconductor.Beta);
-      break; 
-
-    case NMOS_ENH_FLAG: // 6
-      Serial.println("DEVICE: Enhancement NMOS Transistor ");
-      Serial.print("Gate probe = "); Serial.print(toHuman(attr::Semiconductor.Base)); Serial.print("    ");
-      Serial.print("Drain probe = "); Serial.print(toHuman(attr::Semiconductor.Collector)); Serial.print("    ");
-      Serial.print("Source probe = "); Serial.println(toHuman(attr::Semiconductor.Emitter)); 
-      Serial.print("Threshold Vgs = "); Serial.print(attr::Semiconductor._V1_,0); Serial.println(" mV ");
-      //Serial.print("ON State Rds = "); Serial.print(attr::Semiconductor._V2_); Serial.println(" Ohms ");
-      break; 
-
-    case NMOS_DEP_FLAG: // 7
-      Serial.println("DEVICE: Depletion NMOS Transistor ");
-      Serial.print("Gate probe = "); Serial.print(toHuman(attr::Semiconductor.Base)); Serial.print("    ");
-      Serial.print("Drain probe = "); Serial.print(toHuman(attr::Semiconductor.Collector)); Serial.print("    ");
-      Serial.print("Source probe = "); Serial.println(toHuman(attr::Semiconductor.Emitter)); 
-      Serial.print("Threshold Vgs = "); Serial.print(attr::Semiconductor._V1_,0); Serial.println(" mV ");
-      //Serial.print("ON State Rds = "); Serial.print(attr::Semiconductor._V2_); Serial.println(" Ohms ");
-      break; 
-
-    case PMOS_ENH_FLAG: // 8
-      Serial.println("DEVICE: Enhancement PMOS Transistor ");
-      Serial.print("Gate probe = "); Serial.print(toHuman(attr::Semiconductor.Base)); Serial.print("    ");
-      Serial.print("Drain probe = "); Serial.print(toHuman(attr::Semiconductor.Collector)); Serial.print("    ");
-      Serial.print("Source probe = "); Serial.println(toHuman(attr::Semiconductor.Emitter)); 
-      Serial.print("Threshold Vgs = "); Serial.print(attr::Semiconductor._V1_,0); Serial.println(" mV ");
-      //Serial.print("ON State Rds = "); Serial.print(attr::Semiconductor._V2_); Serial.println(" Ohms ");
-      break; 
-
-    case PMOS_DEP_FLAG: // 9
-      Serial.println("DEVICE: Depletion PMOS Transistor ");
-      Serial.print("Gate probe = "); Serial.print(toHuman(attr::Semiconductor.Base)); Serial.print("    ");
-      Serial.print("Drain probe = "); Serial.print(toHuman(attr::Semiconductor.Collector)); Serial.print("    ");
-      Serial.print("Source probe = "); Serial.println(toHuman(attr::Semiconductor.Emitter)); 
-      Serial.print("Threshold Vgs = "); Serial.print(attr::Semiconductor._V1_,0); Serial.println(" mV ");
-      //Serial.print("ON State Rds = "); Serial.print(attr::Semiconductor._V2_); Serial.println(" Ohms ");
-      break;
+    if(pgm_read_byte(&Catalog[i].Flag) != DUT.Flag){ continue; }
+
+    PGM_P Title = (PGM_P) pgm_read_ptr(&Catalog[i].Title);
+    bool Kind = (DUT.Kind && DUT.Kind < sizeof(Kind_Names)/sizeof(Kind_Names[0]));
+    if(Title)
+    {
+      print_P(Msg_Device);
+      if(Kind){ print_P((PGM_P) pgm_read_ptr(&Kind_Names[DUT.Kind])); }
+      print_P(Title);
+      Link.println();
+    }
+    else if(Kind){ print_P((PGM_P) pgm_read_ptr(&Kind_Names[DUT.Kind])); } // Untitled lines (curve points) lead with it
+
+    PGM_P Body = (PGM_P) pgm_read_ptr(&Catalog[i].Body);
+    if(Body){ print_template(Body, DUT); }
+
+    if(DUT.Partial && DUT.Partial < sizeof(Partial_Names)/sizeof(Partial_Names[0]))
+    {
+      print_P((PGM_P) pgm_read_ptr(&Partial_Names[DUT.Partial]));
+      Link.println();
+    }
+    if(DUT.Agree)
+    {
+      print_P(Msg_Agree);
+      Link.println(DUT.Agree);
+    }
+    display_profile(DUT.Profile);
+    return;
   }
+
+  print_P(Msg_Error); // Unknown flag
+  Link.println();
 }
 
-#undef DISP_CPP
\ No newline at end of file
+#undef DISP_CPP
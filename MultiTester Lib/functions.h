@@ -6,29 +6,93 @@
  */
 
 #ifndef TIME_CPP
-    extern byte InductorTMeasure(Probe probeA, Probe probeB, _Bool I_Mode, unsigned long *time);
-    extern byte CapacitorTMeasure(Probe probeA, Probe probeB, byte R_Mode, unsigned long *time);
+    extern byte InductorTMeasure(const Probe &probeA, const Probe &probeB, _Bool I_Mode, unsigned long *time);
+    extern byte CapacitorTMeasure(const Probe &probeA, const Probe &probeB, byte R_Mode, unsigned long *time);
+    extern byte InductorWaveform(const Probe &probeA, const Probe &probeB, _Bool I_Mode, unsigned int period_us, unsigned int *V, byte n);
+    extern byte ResonanceTMeasure(const Probe &probeA, const Probe &probeB, unsigned int *t, byte n, byte *edges);
+    extern byte ChargeTMeasure(const Probe &probe, byte Shunt, byte cycles, byte overflows, unsigned long *time);
 #endif
 
 #ifndef IDENTIFY_CPP
-    extern byte identify( bool Use_Rh, Probe P1, Probe P2, Probe P3 );
+    extern byte identify( Result &DUT, bool Use_Rh );
+    extern bool wait_discharge(const byte ID1, const byte ID2, const byte ID3);
+    extern float Capacitor_Value(Result &DUT, const Probe &probeA, const Probe &probeB, byte R_Mode, unsigned long time);
+#endif
+
+#ifndef SCAN_CPP
+    extern bool Probe_Scan(Scan &S, byte n, bool Use_Rh, byte start = 0, bool reverse = 0);
+    extern bool Scan_Vote(Scan &S, byte n, bool Use_Rh, byte votes, byte *agree);
+    extern byte Scan_State(byte state, byte n);
 #endif
 
 #ifndef MEASURE_CPP
     extern float Resistance_Measure (int RshuntID, int Vcc_ID ,float Rshunt, const int analogPin, bool inverted, bool ignore_internal);
-    extern float Capacitance_Measure(float Rshunt, unsigned long t, bool Is_Big);
+    extern float Capacitance_Measure(Result &DUT, float Rshunt, unsigned long t, bool Is_Big);
+    extern float Capacitance_F(const Result &DUT);
+    extern byte  Charge_Model(Result &DUT, const Probe &A, const Probe &B);
+    extern bool  Capacitor_Leakage(Result &DUT, unsigned long window_ms);
+    extern float Small_Capacitance(byte a, byte b);
+    extern float Stray_pF(byte a, byte b);
+    extern void  Calibrate_Stray();
     extern float Inductance_Measure (float Rshunt, float R_inductor, unsigned long t);
-    extern float Diode_Measure(bool Hi_I, byte Anode, byte Cathode);
-    extern void  NPN_Measure(byte bjt_pins[3]);
-    extern void  PNP_Measure(byte bjt_pins[3]);
-    extern void  MOS_Measure(byte MOSType);
-    extern bool  Get_DS(byte Gate2GND);
-#endif
-
-#ifndef DISP_CPP // The display function is overloaded. Flags allow for versatility within the function, some may not be used yet.
-    extern byte display( Resistor_Specs     DUT, byte dut_flag);
-    extern byte display( Capacitor_Specs    DUT, byte dut_flag);
-    extern byte display( Inductor_Specs     DUT, byte dut_flag);
-    extern byte display( Diode_Specs        DUT, byte dut_flag);
-    extern byte display( Semic_Specs        DUT, byte dut_flag);
+    extern bool  Resonance_Measure(Result &DUT, const Probe &A, const Probe &B);
+    extern bool  Inductance_Fit(Result &DUT, const unsigned int *V, byte n, unsigned int period_us, float R_sense);
+    extern byte  Shunt_Pin(const Probe &P, byte Size, float *R);
+    extern byte  Resistance_Auto(Result &DUT, const Probe &A, const Probe &B, float R_coarse);
+    extern float Diode_Point(const Probe &Anode, byte Anode_Shunt, const Probe &Cathode, byte Cathode_Shunt, float *I);
+    extern void  Diode_Sweep(Result &DUT, const Probe &Anode, const Probe &Cathode);
+    extern bool  RNet_Measure(Result &DUT, bool Use_Rh);
+    extern void  BJT_Measure(Result &DUT, byte BJTType);
+    extern bool  MOS_Measure(Result &DUT, byte MOSType);
+    extern bool  Get_DS(Result &DUT, const Probe &Gate);
+    extern const Probe *Probe_By_ID(byte ID);
+#endif
+
+#ifndef DISP_CPP // Human readable report, chosen by the flag of the result.
+    extern void display( const Result &DUT );
+    extern void display_profile( byte id );
+#endif
+
+
+#ifndef PROTOCOL_CPP
+    extern void  Send_Frame(byte request, const Result &DUT, byte count);
+    extern void  Send_Result(byte request, const Result &DUT);
+#endif
+
+#ifndef PROFILE_CPP
+    extern bool  Profile_Select(byte id);
+    extern byte  Profile_Next();
+#endif
+
+#ifndef BUDGET_CPP
+    extern void  Budget_Start(unsigned int ms);
+    extern byte  Budget_End();
+    extern unsigned long Budget_ms(unsigned long phase_ms);
+    extern void  Budget_Partial(byte reason);
+    extern void  Budget_Timeout(unsigned long allowed_ms, unsigned long phase_ms);
+#endif
+
+#ifndef TEMP_CPP
+    extern float Temperature_Sample();
+    extern float Temperature_Update();
+    extern void  Temperature_Hold(bool hold);
+    extern float Thermal_25C_mV(float V, float tc_mV);
+    extern float Thermal_25C_Pow(float x, float exponent);
+    extern float Thermal_25C_Is(float Is, float n);
+#endif
+
+#ifndef MUX_CPP
+    extern unsigned int Mux_Sweep(byte request, byte sockets, byte rounds, void (*report)(byte request, const Result &DUT));
+#endif
+
+#ifndef METER_CPP
+    extern byte Meter_Run(byte request, Result &DUT, void (*report)(byte request, const Result &DUT));
+#endif
+
+#ifndef CURVE_CPP
+    extern byte Curve_Trace(byte request, const Result &BJT, void (*report)(byte request, const Result &DUT));
+#endif
+
+#ifndef COMMAND_CPP
+    extern bool  Command_Poll();
 #endif
@@ -10,9 +10,9 @@
  * If state 1 is HIGH and state 0 is LOW, selectively pulling up and down the resistors connected to each probe
  * we may well identify the number of terminals of the component.
  * 
- * We will ask to always connect 2 terminal components to probes 1 and 2.Therefore, if any change is detected in
- * the third probe, we will know we have a 3 terminal component. As well, if the third probe impacts the readings of
- * the 1st and 2nd probes, only a 3 terminal component is possible.
+ * 2 terminal components may sit on any pair of probes. The free probe of the pair must read exactly what it is
+ * driven to, otherwise, or if it impacts the readings of the other two, only a 3 terminal component is possible.
+ * The reading patterns of each probe are compared with follows() below.
  *  
  * Out1 Out2 Out3 Readings
  * 0    0    0    OK Check    
@@ -27,278 +27,361 @@
  */
 
 
-bool arr_comp(const bool A1[8], const bool A2[8]) // Compares two boolean arrays of size 8 and returns 1 if they are identical, 0 otherwise.
+/*
+ * Returns 1 if the readings of a probe are HIGH exactly for the combinations that drive HIGH one of the probes in
+ * "mask" (bit p for Probes[p]). An unconnected probe follows itself, a diode anode follows itself too (it only reads
+ * HIGH when driven), while both ends of a short circuit and a diode cathode follow the pair.
+ */
+bool follows(const bool C[8], byte mask)
 {
     for(byte i = 1; i < 7; i ++)
     {
-        if(A1[i] != A2[i]){return 0;}
+        if(C[i] != ((i & mask) != 0)){return 0;}
     }
     return 1;
 }
 
 bool wait_discharge(const byte ID1, const byte ID2, const byte ID3)
 {
-    byte t = 0;
-    do{
+    unsigned long Allowed = Budget_ms(DISCHARGE_TIMEOUT_MS);
+    unsigned int t = 0;
+    while( (analogRead(ID1) > 1) | (analogRead(ID2) > 1) | (analogRead(ID3) > 1) ) // If we read some voltage we continue to discharge
+    {
         delay(100); // Wait for discharge
         t = t+1;
-        if (t>100){return 1;} // Raise error. We have taken too long.
-    }while( (analogRead(ID1) > 1) | (analogRead(ID2) > 1) | (analogRead(ID3) > 1) ); // If we read some voltage we continue to discharge
-    return 0;
+        if (t*100UL > Allowed) // Raise error. We have taken too long.
+        {
+            Budget_Partial(PARTIAL_TIMEOUT); // Whichever limit cut it, the parts are not discharged
+            return 1;
+        }
+    }
+    return 0; // Already discharged parts (see mux.cpp) do not wait at all
 }
 
 byte remaining_probe(byte A, byte B)
 {
-    byte AllProbes[3] = {P1.ID, P2.ID, P3.ID};
-    for(byte i=0; i<3; i++)
+    for(byte p=0; p<3; p++)
     {
-        if((AllProbes[i] != A) && (AllProbes[i] != B))
+        if((Probes[p]->ID != A) && (Probes[p]->ID != B))
         {
-            return AllProbes[i];
+            return Probes[p]->ID;
         }
     }
     return 0;
 }
 
-byte isRL(bool Use_Rh, unsigned long time)
+// ID of the probe driven HIGH alone by the combination (bit p drives Probes[p]), 0 if several are.
+byte single_probe(byte combination)
 {
-    float R_val = 0;
+    for(byte p=0; p<3; p++)
+    {
+        if(combination == (1 << p)){ return Probes[p]->ID; }
+    }
+    return 0;
+}
+
+// ID of the only probe reading LOW for the combination, the others reading HIGH (0 if there is none).
+byte low_probe(const bool C[3][8], byte combination)
+{
+    byte low = 0;
+    byte count = 0;
+    for(byte p=0; p<3; p++)
+    {
+        if(!C[p][combination]){ low = Probes[p]->ID; count ++; }
+    }
+    return (count == 1) ? low : 0;
+}
 
-    if(Use_Rh)
+/*
+ * Looks for a capacitor too small to time with CapacitorTMeasure (see Small_Capacitance), once the scan has found no
+ * conduction at all: junctions and gates also hold some pF, but the scan sees them conduct. Takes the pair with the
+ * largest capacitance. Returns 1 if one was found.
+ */
+bool small_capacitor(Result &DUT)
+{
+    float C_small = 0;
+    Role_Map Small(2);
+    do
     {
-        R_val = Resistance_Measure(P1.Rm, P2.ID, P1.Rm_val, P1.ID, 0, 1); // Medium Resistances by default (works well under 150kOhms)
+        if(Small.Index[ROLE_A] > Small.Index[ROLE_B]){ continue; }
 
-        if(R_val > 150){ R_val = Resistance_Measure(P1.Rh, P2.ID, P1.Rh_val, P1.ID, 0, 1);} // Using high value R to make the measure
+        float C = Small_Capacitance(Small.Index[ROLE_A], Small.Index[ROLE_B]);
+        if(C > C_small)
+        {
+            C_small = C;
+            DUT.Pins[ROLE_A] = Small[ROLE_A].ID;
+            DUT.Pins[ROLE_B] = Small[ROLE_B].ID;
+        }
+    } while(Small.next());
 
-        attr::Resistor.R_Value = R_val;
-        attr::Resistor.Power = 'k';
+    DUT.Value[V_CAPACITANCE] = C_small;
+    DUT.Power = 'p';
+    return C_small > 0;
+}
 
-        return RESISTOR_FLAG; // Cannot possibly be an inductor if we needed high resistance. (We couldn't measure it either)
+// Converts the charge time of CapacitorTMeasure() into a capacitance, with the shunts used by each R_Mode.
+float Capacitor_Value(Result &DUT, const Probe &probeA, const Probe &probeB, byte R_Mode, unsigned long time)
+{
+    float R_tot = 0.0;
+
+    if(R_Mode == 2)
+    {
+        R_tot = probeB.Rh_val() + (probeA.Rl_val()) / 1000.0;
     }
-    
-    if (time != 0){ time = 0; } // Sanity check;
+    else if(R_Mode == 0) // Big capacitors
+    {
+        R_tot = probeB.Rl_val() + (INTERNAL_R_LOW + INTERNAL_R_HIGH) / 1000.0;
+    }
+    else
+    {
+        R_tot = probeB.Rm_val() + (probeA.Rl_val() + INTERNAL_R_LOW + INTERNAL_R_HIGH) / 1000.0;
+    }
+    return Capacitance_Measure(DUT, R_tot, time, R_Mode == 0);
+}
+
+/*
+ * Quick charge test, to find the pair a capacitor sits on before timing it. Probe A is charged through its Rl with B
+ * held LOW, and the voltage across the pair is followed while it charges:
+ *
+ *  - still rising at the end of RETENTION_CHARGE_MS, a large capacitor (1 mF through both Rl only gains some LSB,
+ *    far too little to be told from the noise once the charge stops). A resistor sits at a steady divider.
+ *  - at the rail, a floating pair or a capacitor already full. The charge stops there, and A is left to bleed
+ *    through its Rh for a moment: the stray capacitance of a floating probe empties in some tens of microseconds,
+ *    a capacitor (above ~100 pF) keeps most of its charge.
+ *
+ * *timeout is set if the pair could not be discharged afterwards (see wait_discharge).
+ */
+bool holds_charge(const Probe &A, const Probe &B, bool *timeout)
+{
+    pinMode(A.ID, INPUT);
+    pinMode(B.ID, INPUT);
+    pinMode(A.Rl, OUTPUT);
+    pinMode(B.Rl, OUTPUT);
+    digitalWrite(B.Rl, LOW);
+    digitalWrite(A.Rl, HIGH);
+
+    unsigned long start = millis();
+    int first = -1, across = 0;
+    do
+    {
+        across = analogRead(A.ID) - analogRead(B.ID);
+        if(first < 0){ first = across; }
+    } while(across < RETENTION_FULL_LSB && millis() - start < RETENTION_CHARGE_MS);
 
-    float R_shunt = P1.Rl_val;
-    int Tflag = InductorTMeasure(P1, P2, 0, &time); // First testing big inductances
+    digitalWrite(A.Rl, LOW);
+    pinMode(A.Rl, INPUT);
 
-    if( Tflag == 1 | Tflag == 2) // Too low time reading, testing low inductance
+    bool held = (across - first > RETENTION_RISE_LSB);
+    if(across >= RETENTION_FULL_LSB)
     {
-        if (time != 0){ time = 0; } // Reset time
+        pinMode(A.Rh, OUTPUT);
+        digitalWrite(A.Rh, LOW);
+        delayMicroseconds(RETENTION_WAIT_US);
+        held = (analogRead(A.ID) > RETENTION_THRESHOLD);
+    }
 
-        R_shunt = 0; // With Low Inductances we rely purely on internal resistances.
-        Tflag = InductorTMeasure(P1, P2, 1, &time);
+    pinMode(A.Rl, OUTPUT); // Discharging for the next test
+    *timeout = wait_discharge(A.ID, B.ID, B.ID);
+    pinMode(A.Rl, INPUT);
+    pinMode(A.Rh, INPUT);
+    pinMode(B.Rl, INPUT);
 
-        if( Tflag == 1 | Tflag == 2 | Tflag == 10) // Still no significant time measures, must be a resistor/short circuit
-        {
-            R_val = Resistance_Measure(P1.Rl, P2.ID, P1.Rl_val, P1.ID, 0, 0); // Expecting low R by default
-            
-            if(R_val > 4500) // Medium-value (22k) resistances are better suited to measure the kOhm range
-            {
-                R_val = Resistance_Measure(P1.Rm, P2.ID, P1.Rm_val, P1.ID, 0, 1);
-                attr::Resistor.Power = 'k';
-            }
-            else
-            {
-                attr::Resistor.Power = ' ';
-            }
+    return held;
+}
 
-            attr::Resistor.R_Value = R_val;
+/*
+ * Resistor or inductor, on a pair conducting both ways. One R/L engine working from a single set of acquisitions:
+ *
+ *  1. The DC points both ways round through Rl, taken by the caller to rule out a Zener, give R_dc.
+ *  2. One InductorTMeasure, in high current mode for the pairs below RL_HIGH_CURRENT_MAX_R (through the shunt
+ *     otherwise, as the internal resistances alone would not raise the bandgap across them). A time too short
+ *     to read means no inductance.
+ *  3. For an inductor, the sampled pulse (see Inductance_Fit) when the rise is slow enough for the ADC.
+ *
+ * R_dc is the R_parasit of an inductor. For a resistor it is the coarse value choosing the range of its single
+ * precise pass (see Resistance_Auto), nothing is measured twice.
+ */
+byte isRL(Result &DUT, bool Use_Rh, const Probe &A, const Probe &B, float R_dc)
+{
+    DUT.Pins[ROLE_A] = A.ID;
+    DUT.Pins[ROLE_B] = B.ID;
 
-            return RESISTOR_FLAG;
-        }
+    if(Use_Rh) // Cannot possibly be an inductor if we needed high resistance. (We couldn't measure it either)
+    {
+        Resistance_Auto(DUT, A, B, -1);
+        return RESISTOR_FLAG;
     }
 
-    if( Tflag == 10 )
+    // Through Rl the current of an inductor with this much resistance never raises the bandgap across the shunt
+    if(R_dc > (A.Rl_val() + INTERNAL_R_LOW) * (5 / BANDGAP_V - 1) - INTERNAL_R_HIGH)
     {
-        return 0; // This should not happen, we detected a shortcircuit and an open circuit simulataneously.
+        Resistance_Auto(DUT, A, B, R_dc);
+        return RESISTOR_FLAG;
     }
 
-    attr::Inductor.R_parasit = Resistance_Measure(P1.Rl, P2.ID, P1.Rl_val, P1.ID, 0, 0);
-    attr::Inductor.L_Value = Inductance_Measure(R_shunt, attr::Inductor.R_parasit, time);
-    
-    return INDUCTOR_FLAG;
-}
+    bool High_Current = (R_dc < RL_HIGH_CURRENT_MAX_R);
+    float R_shunt = High_Current ? 0 : A.Rl_val(); // With Low Inductances we rely purely on internal resistances.
+    unsigned long time = 0;
+    int Tflag = InductorTMeasure(A, B, High_Current, &time);
 
+    if( Tflag == 1 | Tflag == 2 | Tflag == 10) // No significant time measures, must be a resistor/short circuit
+    {
+        // Unless it is a coil too small to time: those ring against the reference capacitor (either way round)
+        if(!Resonance_Measure(DUT, A, B) || !Resonance_Measure(DUT, B, A)){ return INDUCTOR_FLAG; }
 
-byte identify( bool Use_Rh, Probe P1, Probe P2, Probe P3 )
-{
-       
-    byte R1 = P1.Rl;
-    byte R2 = P2.Rl;
-    byte R3 = P3.Rl;
+        Resistance_Auto(DUT, A, B, R_dc);
+        return RESISTOR_FLAG;
+    }
 
-    if (Use_Rh) // We may need this for big resistances or capacitors
+    /*
+     * Slow enough rises are sampled in a single pulse and fitted (see Inductance_Fit). The time to the bandgap gives
+     * tau well enough to spread RL_SAMPLES over RL_SPAN_TAU of them.
+     */
+    float R_sense = R_shunt + INTERNAL_R_LOW;
+    float r = BANDGAP_V * (R_sense + INTERNAL_R_HIGH + R_dc) / (5 * R_sense);  // I(t)/I0 at the bandgap
+    float tau_us = (r < 1) ? -(time / 1000.0) / log(1 - r) : 0;
+    float period_us = tau_us * RL_SPAN_TAU / RL_SAMPLES;
+    bool fitted = 0;
+
+    if(period_us >= RL_MIN_PERIOD_US && period_us < 30000)
+    {
+        unsigned int V[RL_SAMPLES];
+        fitted = !InductorWaveform(A, B, High_Current, period_us, V, RL_SAMPLES)
+                 && !Inductance_Fit(DUT, V, RL_SAMPLES, period_us, R_sense);
+    }
+    if(!fitted) // Too fast for the ADC: the bandgap time
     {
-        R1 = P1.Rh;
-        R2 = P2.Rh;
-        R3 = P3.Rh;
+        DUT.Value[V_INDUCTANCE] = Inductance_Measure(R_shunt, R_dc, time);
     }
+    DUT.Value[V_R_PARASIT] = R_dc; // The DC points are more accurate than the fit for it
+    DUT.Power = 'u';
 
-    pinMode(P1.ID, INPUT); // Starting up INPUT pins
-    pinMode(P2.ID, INPUT);
-    pinMode(P3.ID, INPUT);
+    return INDUCTOR_FLAG;
+}
 
-    pinMode(P1.Rl, OUTPUT); // Starting up OUTPUT pins
-    pinMode(P2.Rl, OUTPUT);
-    pinMode(P3.Rl, OUTPUT);
 
-    digitalWrite(P1.Rl, LOW); // Setting everything to GND, in case of charged components.
-    digitalWrite(P2.Rl, LOW);
-    digitalWrite(P3.Rl, LOW);
+static bool Rescanned = 0; // The robust mode fell back to a full identification, once at most
+
+byte identify_device( Result &DUT, bool Use_Rh )
+{
+    for(byte p = 0; p < 3; p++)
+    {
+        pinMode(Probes[p]->ID, INPUT);      // Starting up INPUT pins
+        pinMode(Probes[p]->Rl, OUTPUT);     // Starting up OUTPUT pins
+        digitalWrite(Probes[p]->Rl, LOW);   // Setting everything to GND, in case of charged components.
+    }
 
     if(wait_discharge(P1.ID, P2.ID, P3.ID)){ return 100; } // Timeout error
 
-    pinMode(P1.Rl, INPUT); // We will measure capacitance now, we need Hi-Z
-    pinMode(P2.Rl, INPUT);
-    pinMode(P3.Rl, INPUT);
+    for(byte p = 0; p < 3; p++){ pinMode(Probes[p]->Rl, INPUT); } // We will measure capacitance now, we need Hi-Z
+
+    // Pair to time as a capacitor: the one holding charge, the first two probes if none does (small capacitors)
+    const Probe *CapA = Probes[0];
+    const Probe *CapB = Probes[1];
+    Role_Map Cap(2);
+    do
+    {
+        if(Cap.Index[ROLE_A] > Cap.Index[ROLE_B]){ continue; }
+
+        bool Timeout = 0;
+        bool held = holds_charge(Cap[ROLE_A], Cap[ROLE_B], &Timeout);
+        if(Timeout){ return 100; } // Timeout error, the budget is spent
+        if(held)
+        {
+            CapA = &Cap[ROLE_A];
+            CapB = &Cap[ROLE_B];
+            break;
+        }
+    } while(Cap.next());
 
     unsigned long time = 0;
     byte Cap_timetest = 1;
-    bool Is_Big = 0;
+    byte R_Mode = 1;
     
     if(Use_Rh) // This earns us some time
     {
-        Cap_timetest = CapacitorTMeasure(P1, P2, 2, &time);
+        R_Mode = 2;
+        Cap_timetest = CapacitorTMeasure(*CapA, *CapB, R_Mode, &time);
     }
     else
     {
-        Cap_timetest = CapacitorTMeasure(P1, P2, 1, &time);
-        if(Cap_timetest == 10) // Timeout Flag
+        // The shape of the charge finds a resistor across the capacitor, or a DC path the timing would wait 2 s on
+        byte Model = Charge_Model(DUT, *CapA, *CapB);
+        if(Model == CHARGE_TIMEOUT){ return 100; } // Timeout error, the budget is spent
+        if(Model == CHARGE_RC)
         {
-            Cap_timetest = CapacitorTMeasure(P1, P2, 0, &time);
-            Is_Big = 1;
+            DUT.Pins[ROLE_A] = CapA->ID;
+            DUT.Pins[ROLE_B] = CapB->ID;
+            return CAPACITOR_FLAG;
+        }
+
+        if(Model == CHARGE_CAPACITOR)
+        {
+            Cap_timetest = CapacitorTMeasure(*CapA, *CapB, R_Mode, &time);
+            if(Cap_timetest == 10) // Timeout Flag
+            {
+                R_Mode = 0; // Big capacitor
+                Cap_timetest = CapacitorTMeasure(*CapA, *CapB, R_Mode, &time);
+            }
         }
     }
 
-    float R_tot = 0.0;
     if(!Cap_timetest) // Capacitor detected
     {
-        if(Use_Rh)
-        { 
-            R_tot = P2.Rh_val + (P1.Rl_val) / 1000.0;
-            attr::Capacitor.C_Value = Capacitance_Measure(R_tot, time, Is_Big);
-        }
-        else if(Is_Big)
-        {
-            R_tot = P2.Rl_val + (INTERNAL_R_LOW + INTERNAL_R_HIGH) / 1000.0;
-            attr::Capacitor.C_Value = Capacitance_Measure(R_tot, time, Is_Big);
-        }
-        else
-        {
-            R_tot = P2.Rm_val + (P1.Rl_val + INTERNAL_R_LOW + INTERNAL_R_HIGH) / 1000.0;
-            attr::Capacitor.C_Value = Capacitance_Measure(R_tot, time, Is_Big);
-        }
+        DUT.Value[V_CAPACITANCE] = Capacitor_Value(DUT, *CapA, *CapB, R_Mode, time);
+        DUT.Pins[ROLE_A] = CapA->ID;
+        DUT.Pins[ROLE_B] = CapB->ID;
         return CAPACITOR_FLAG;
     }
 
     delay(10);
-    // Serial.print(analogRead(P1.ID));
-    //         Serial.print(" | ");
-    // Serial.print(analogRead(P2.ID));
-    //         Serial.print(" | ");
-    // Serial.println(analogRead(P3.ID));
-    // Serial.println("Analog");
-
-    pinMode(R1, OUTPUT); // Starting up OUTPUT pins
-    pinMode(R2, OUTPUT);
-    pinMode(R3, OUTPUT);
-
-    digitalWrite(R1, LOW); // Setting everything to GND, in case of charged components again
-    digitalWrite(R2, LOW);
-    digitalWrite(R3, LOW);
-
-    if(wait_discharge(P1.ID, P2.ID, P3.ID)){ return 100; } // Timeout error
-
-    byte combinations = 1;
-    unsigned long response = 0;
+    // Link.print(analogRead(P1.ID));
+    //         Link.print(" | ");
+    // Link.print(analogRead(P2.ID));
+    //         Link.print(" | ");
+    // Link.println(analogRead(P3.ID));
+    // Link.println("Analog");
+
+    Scan S; // The combinatory, see scan.cpp
+    if(attr::Consensus) // Robust mode: scans repeated until enough of them agree
+    {
+        if(Scan_Vote(S, 3, Use_Rh, attr::Consensus, &DUT.Agree)){ return 100; } // Timeout error
+        if(DUT.Agree < attr::Consensus && !Rescanned) // Disagreement: the whole identification again, discharge first
+        {
+            Rescanned = 1;
+            DUT.clear();
+            return identify_device(DUT, Use_Rh);
+        }
+    }
+    else if(Probe_Scan(S, 3, Use_Rh)){ return 100; } // Timeout error
 
     bool changed[8];    // Bits that have changed
     byte count = 0;     // We count the number of changes that occurred.
-    byte step = 1;      // Steps of the measure process
-    bool C1[8] = {0,0,0,0,0,0,0,0}; // Initializing our binary measure buffers
-    bool C2[8] = {0,0,0,0,0,0,0,0};
-    bool C3[8] = {0,0,0,0,0,0,0,0};
-    
-    while(step <= 4) // 4 Steps are needed for the measuring process to complete, one for each buffer and a final one for data post-processing
-    {
-        while (combinations < 0b111){ // moves up to go through all the 6 useful combinations.
-            digitalWrite(R1, combinations & 0b1); // Writes HIGH if the flag is set, LOW otherwise.
-            digitalWrite(R2, combinations & 0b10);
-            digitalWrite(R3, combinations & 0b100);
-            delay(10);
-            // Translating readings into binary values (1 = HIGH, 0 = LOW)
-            if(step == 1) 
-            {
-                if(Use_Rh){analogRead(P1.ID);} // First measures have been observed to be unreliable with high impedances
-                
-                C1[combinations] = (analogRead(P1.ID) > 20);
-            }
-            
-            else if(step == 2)
-            {
-                if(Use_Rh){analogRead(P2.ID);}
-                
-                C2[combinations] = (analogRead(P2.ID) > 20);
-            }
-            
-            else if(step == 3)
-            {
-                if(Use_Rh){analogRead(P3.ID);}
-                
-                C3[combinations] = (analogRead(P3.ID) > 20); 
-            }
+    bool C[3][8] = {{0,0,0,0,0,0,0,0}, {0,0,0,0,0,0,0,0}, {0,0,0,0,0,0,0,0}}; // Binary measure buffers, one per probe
 
-            else if(step == 4)
-            {
-                bool CC = ( (C1[combinations] | C2[combinations] << 1 | C3[combinations] << 2) != combinations );
-                changed[combinations] = CC; // If there is a change with respect to the input this will flag it.
-                count += CC;
-
-                /*
-                * Now we have the answer of our device to all possible input combinations. The input is stored in "combinations",
-                * the output in "response" in the form of binary values representing state HIGH with 1 and state LOW with 0. 
-                * We also compare the input with the output and store it in "comparison". If the input is equal to the output, we get 0, otherwise we get 1.
-                * We will go through different cases to identify the components:
-                */
-            }
-            else{ return 0; } // Raise Error
-            combinations ++;
-            /*
-            * NOTE:
-            * The repeated measures of analogRead to discard the first measurements are inefficient,
-            * but it  is the only method that has been observed to work. Our suspicion is that we are limited by the
-            * charging of the Sample and Hold capacitor of the ADC, which is not though to work under High Impedance frameworks.
-            * The only possible way to avoid these effects is to allow it to charge properly by dismissing the first readings.
-            * Possibly, only the first two readings at the start of each step need to be discarded, but given the time taken is
-            * negligible for the user, we have chosen what we think is a better option in terms of reliability, whicle we sacrifice
-            * some time and efficiency.
-            * 
-            * Any new solutions that would make the measurement scheme cleaner will be welcome.
-            */
-        }
-        
-        combinations = 1;
-        step ++;
-    }
-    // Shutting down the pins.   
-    digitalWrite(R1, LOW); 
-    digitalWrite(R2, LOW);
-    digitalWrite(R3, LOW);
-    
-    if(wait_discharge(P1.ID, P2.ID, P3.ID)){ return 101; } // Timeout error 2
+    /*
+    * Now we have the answer of our device to all possible input combinations (1 = HIGH, 0 = LOW). Bit p of the
+    * combination drives Probes[p] HIGH. "changed" flags the combinations where the output differs from the input.
+    * We will go through different cases to identify the components:
+    */
+    unsigned int changes = S.changes();
+    for(byte s = 0; s < 6; s++) // With three probes the scan visits the 6 useful combinations
+    {
+        byte combination = Scan_State(s, 3);
+        for(byte p = 0; p < 3; p++){ C[p][combination] = (S.Signature[p] >> s) & 1; }
 
-    pinMode(R1, INPUT); // Shutting down resistor pins
-    pinMode(R2, INPUT);
-    pinMode(R3, INPUT);
+        changed[combination] = (changes >> s) & 1;
+        count += changed[combination];
+    }
 
     // for(int i  = 0; i < 8; i++) // Debug Purposes
     // {
-    //     Serial.print(C3[i]); // Works as long as Serial.begin is called in setup()
-    //     Serial.print(" | ");
-    //     Serial.print(C2[i]);
-    //     Serial.print(" | ");
-    //     Serial.print(C1[i]);
-    //     Serial.println("");
+    //     Link.print(C[2][i]); // Works as long as Link.begin is called in setup()
+    //     Link.print(" | ");
+    //     Link.print(C[1][i]);
+    //     Link.print(" | ");
+    //     Link.print(C[0][i]);
+    //     Link.println("");
     // }
 
     /***********************************
@@ -306,46 +389,60 @@ byte identify( bool Use_Rh, Probe P1, Probe P2, Probe P3 )
     ***********************************/
     if(count == 0)  // Either a Capacitor or open circuit.
     {
-        if(Use_Rh){return OPEN_CIRCUIT_FLAG;}
+        if(Use_Rh){return small_capacitor(DUT) ? CAPACITOR_FLAG : OPEN_CIRCUIT_FLAG;}
         else
         {
-            return identify(1, P1, P2, P3); // This will call the function again and tell it to use a high resistance value
+            return identify_device(DUT, 1); // This will call the function again and tell it to use a high resistance value
         } 
     }
-    // TWO TERMINAL Devices, assuming always connected to probes 1 and 2. These Values can be found in the config.h file.
-    /*
-    const bool diode_C1anode[8] = {0,1,0,1,0,1,0,0};
-    const bool diode_C2anode[8] = {0,0,1,1,0,0,1,0};
-
-    const bool C3unused[8] = {0,0,0,0,1,1,1,0}; // Specific for C3
-    const bool C1C2shortcircuit[8] = {0,1,1,1,0,1,1,0};
-    */
+    // TWO TERMINAL Devices, on whichever pair of probes the free one shows
+    Role_Map Pair(2);
+    do
+    {
+        byte a = Pair.Index[ROLE_A];
+        byte b = Pair.Index[ROLE_B];
+        byte unused = 3 - a - b; // Probe left out of the pair
+        byte both = (1 << a) | (1 << b);
 
-    if(arr_comp(C3, C3unused)){
+        if(a > b || !follows(C[unused], 1 << unused)){ continue; } // Each pair once, with the third probe free
 
-        if( arr_comp(C1, C1C2shortcircuit) && arr_comp(C2, C1C2shortcircuit)) // What the output looks for a short-circuit (low enough R / Inductor)
+        if( follows(C[a], both) && follows(C[b], both) ) // What the output looks for a short-circuit (low enough R / Inductor)
         {
-            return isRL(Use_Rh, time); // Measuring Resistances and Inductances
-        }
+            // A Zener below 5 V conducts both ways as well, only its drops tell it from a resistor
+            float I_ab = 0;
+            float I_ba = 0;
+            float V_ab = Diode_Point(Pair[ROLE_A], SHUNT_L, Pair[ROLE_B], SHUNT_NONE, &I_ab);
+            float V_ba = Diode_Point(Pair[ROLE_B], SHUNT_L, Pair[ROLE_A], SHUNT_NONE, &I_ba);
 
-        else if( arr_comp(C1, diode_C1anode) && arr_comp(C2, C1C2shortcircuit) )
-        {
-            attr::Diode.Anode   = P1.ID;
-            attr::Diode.Cathode = P2.ID;
-            attr::Diode.VdH_Value = Diode_Measure(0, P1.ID, P2.ID); // High  Intensity measure
-            attr::Diode.VdL_Value = Diode_Measure(1, P1.ID, P2.ID); // Low Intensity measure
-            return DIODE_AC_FLAG;
+            if(fabs(V_ab - V_ba) > ZENER_ASYMMETRY_MV)
+            {
+                bool forward = V_ab < V_ba; // The anode is on the side with the lower drop
+                Diode_Sweep(DUT, forward ? Pair[ROLE_A] : Pair[ROLE_B], forward ? Pair[ROLE_B] : Pair[ROLE_A]);
+                return forward ? DIODE_AC_FLAG : DIODE_CA_FLAG;
+            }
+            // Both points also give the DC resistance of the pair (mV / A, to Ohms)
+            float R_dc = (I_ab > 0 && I_ba > 0) ? (V_ab / I_ab + V_ba / I_ba) / 2000 : 0;
+            return isRL(DUT, Use_Rh, Pair[ROLE_A], Pair[ROLE_B], R_dc); // Measuring Resistances and Inductances
         }
 
-        else if( arr_comp(C2, diode_C2anode) && arr_comp(C1, C1C2shortcircuit) )
+        for(byte anode = 0; anode < 2; anode++) // Diode, anode on the first probe of the pair (AC) or on the second (CA)
         {
-            attr::Diode.Anode   = P2.ID;
-            attr::Diode.Cathode = P1.ID;
-            attr::Diode.VdH_Value = Diode_Measure(0, P2.ID, P1.ID); // High  Intensity measure
-            attr::Diode.VdL_Value = Diode_Measure(1, P2.ID, P1.ID); // Low Intensity measure
-            return DIODE_CA_FLAG;   
+            byte A = anode ? b : a;
+            byte K = anode ? a : b;
+
+            if( follows(C[A], 1 << A) && follows(C[K], both) )
+            {
+                Diode_Sweep(DUT, *Probes[A], *Probes[K]); // Multi point measure and model fit
+                return anode ? DIODE_CA_FLAG : DIODE_AC_FLAG;
+            }
         }
-    }
+    } while(Pair.next());
+
+    // Resistor network (potentiometer, array): current flows both ways between every pair of probes
+    bool network = 1;
+    for(byte p = 0; p < 3; p++){ network &= (S.Link[p] == (0b111 & ~(1 << p))); }
+
+    if(network && !RNet_Measure(DUT, Use_Rh)){ return RESISTOR_NET_FLAG; }
 
     // THREE TERMINAL devices (semiconductors)
     
@@ -357,30 +454,22 @@ byte identify( bool Use_Rh, Probe P1, Probe P2, Probe P3 )
     byte bjt_count_111 = 0;
     byte bjt_pins[3] = {0,0,0};
 
-    // For MOS
-    byte Drain_Rl = 0;
-    byte Source_Rl = 0;
-    byte Gate_Rh = 0;
-    byte Gate_Rl = 0;
-
     if(count == 4) // NMOS - depletion (Could be PMOS - depletion, but these devices are not manufactured)
     {
-        bool Gate_Slow =0;
         for(byte i = 1; i<7; i++) // Useful combinations
         {
-            is_111 = (C1[i] & C2[i] & C3[i]);
-            if(changed[i] && !is_111) 
+            is_111 = (C[0][i] & C[1][i] & C[2][i]);
+            if(changed[i] && !is_111 && low_probe(C, i)) 
             {
-                if      (C2[i] & C3[i]){ attr::Semiconductor.Base = P1.ID; Gate_Slow = P1.Rl;} // The probe with a non-powered reading is the Gate
-                else if (C1[i] & C3[i]){ attr::Semiconductor.Base = P2.ID; Gate_Slow = P2.Rl;}
-                else if (C1[i] & C2[i]){ attr::Semiconductor.Base = P3.ID; Gate_Slow = P3.Rl;}
+                DUT.Pins[ROLE_GATE] = low_probe(C, i); // The probe with a non-powered reading is the Gate
 
                 // TODO: Diode measure
             }
         }
-        if(Get_DS(Gate_Slow)) // If we can identify Source and Drain we may carry out other measures
+        const Probe *Gate = Probe_By_ID(DUT.Pins[ROLE_GATE]);
+        if(Gate && Get_DS(DUT, *Gate)) // If we can identify Source and Drain we may carry out other measures
         {
-            MOS_Measure(NMOS_DEP_FLAG);
+            MOS_Measure(DUT, NMOS_DEP_FLAG);
         }
         return NMOS_DEP_FLAG;
     }
@@ -388,27 +477,13 @@ byte identify( bool Use_Rh, Probe P1, Probe P2, Probe P3 )
     // BJT loop:
     for(int i = 1; i<7; i++)
     {
-        is_111 = C1[i] & C2[i] & C3[i]; // is 1 if we have read 111.
+        is_111 = C[0][i] & C[1][i] & C[2][i]; // is 1 if we have read 111.
         count_111 += is_111;
 
-
-        if (changed[i] && is_111) // Changed and all pins had power (BJT)
+        if (changed[i] && is_111 && single_probe(i)) // Changed and all pins had power (BJT)
         { 
-            switch (i)
-            {
-                case 0b001:
-                    bjt_pins[bjt_count_111] = P1.ID;
-                    bjt_count_111 ++;
-                    break;
-                case 0b010:
-                    bjt_pins[bjt_count_111] = P2.ID;
-                    bjt_count_111 ++;
-                    break;
-                case 0b100:
-                    bjt_pins[bjt_count_111] = P3.ID;
-                    bjt_count_111 ++;
-                    break;
-            }
+            bjt_pins[bjt_count_111] = single_probe(i);
+            bjt_count_111 ++;
         }
     }
 
@@ -419,12 +494,14 @@ byte identify( bool Use_Rh, Probe P1, Probe P2, Probe P3 )
     }
     else if(bjt_count_111 == 1) // 111 was read once, we powered the base of a NPN
     {
-        NPN_Measure(bjt_pins);
+        DUT.Pins[ROLE_BASE] = bjt_pins[0];
+        BJT_Measure(DUT, NPN_FLAG);
         return NPN_FLAG;
     }
     else if(bjt_count_111 == 2) // 111 was read twice, we powered the emitter & collector of a PNP
     {
-        PNP_Measure(bjt_pins);
+        DUT.Pins[ROLE_BASE] = remaining_probe(bjt_pins[0], bjt_pins[1]); // The base is the one that is not an anode
+        BJT_Measure(DUT, PNP_FLAG);
         return PNP_FLAG;
     }
     else if(count_111 == 1 && count == 3) // PMOS
@@ -433,32 +510,19 @@ byte identify( bool Use_Rh, Probe P1, Probe P2, Probe P3 )
         // Identifying drain, gate and source
         for(byte i = 1; i<7; i++) // Useful combinations
         {
-            is_111 = (C1[i] & C2[i] & C3[i]);
+            is_111 = (C[0][i] & C[1][i] & C[2][i]);
             if(changed[i] && is_111) // The non-powered probe is the source
             {
-                switch (i)
-                {
-                    case 0b110:
-                        attr::Semiconductor.Emitter = P1.ID; // This name is not the best
-                        break;
-                    case 0b101:
-                        attr::Semiconductor.Emitter = P2.ID;
-                        break;
-                    case 0b011:
-                        attr::Semiconductor.Emitter = P3.ID;
-                        break;
-                }
+                if(single_probe(~i & 0b111)){ DUT.Pins[ROLE_SOURCE] = single_probe(~i & 0b111); }
             }
-            else if(changed[i] && !is_111) 
+            else if(changed[i] && !is_111 && low_probe(C, i)) 
             {
-                if      (C2[i] & C3[i]){ attr::Semiconductor.Base = P1.ID; } // The probe with a non-powered reading is the Gate
-                else if (C1[i] & C3[i]){ attr::Semiconductor.Base = P2.ID; }
-                else if (C1[i] & C2[i]){ attr::Semiconductor.Base = P3.ID; }
+                DUT.Pins[ROLE_GATE] = low_probe(C, i); // The probe with a non-powered reading is the Gate
             }
         }
-        attr::Semiconductor.Collector = remaining_probe(attr::Semiconductor.Emitter, attr::Semiconductor.Base);
+        DUT.Pins[ROLE_DRAIN] = remaining_probe(DUT.Pins[ROLE_SOURCE], DUT.Pins[ROLE_GATE]);
 
-        MOS_Measure(PMOS_ENH_FLAG);
+        MOS_Measure(DUT, PMOS_ENH_FLAG);
 
         return PMOS_ENH_FLAG;
     }
@@ -467,34 +531,38 @@ byte identify( bool Use_Rh, Probe P1, Probe P2, Probe P3 )
         //nmos_enh_measure();
         for(byte i = 1; i<7; i++) // Useful combinations
         {
-            is_111 = (C1[i] & C2[i] & C3[i]);
+            is_111 = (C[0][i] & C[1][i] & C[2][i]);
             if(changed[i] && !is_111) 
             {
-                if      (C2[i] & C3[i]){ attr::Semiconductor.Base = P1.ID; } // The probe with a non-powered reading is the Gate
-                else if (C1[i] & C3[i]){ attr::Semiconductor.Base = P2.ID; }
-                else if (C1[i] & C2[i]){ attr::Semiconductor.Base = P3.ID; }
-
-                switch (i)// The only powered probe is the source
-                {
-                    case 0b001:
-                        attr::Semiconductor.Emitter = P1.ID; // This name is not the best
-                        break;
-                    case 0b010:
-                        attr::Semiconductor.Emitter = P2.ID;
-                        break;
-                    case 0b100:
-                        attr::Semiconductor.Emitter = P3.ID;
-                        break;
-                }
+                if(low_probe(C, i)){ DUT.Pins[ROLE_GATE] = low_probe(C, i); } // The probe with a non-powered reading is the Gate
+
+                if(single_probe(i)){ DUT.Pins[ROLE_SOURCE] = single_probe(i); } // The only powered probe is the source
             }
         }
-        attr::Semiconductor.Collector = remaining_probe(attr::Semiconductor.Emitter, attr::Semiconductor.Base);
+        DUT.Pins[ROLE_DRAIN] = remaining_probe(DUT.Pins[ROLE_SOURCE], DUT.Pins[ROLE_GATE]);
 
-        MOS_Measure(NMOS_ENH_FLAG);
+        MOS_Measure(DUT, NMOS_ENH_FLAG);
         return NMOS_ENH_FLAG;
     }
 
     return 0; // NOT IDENTIFIED
 }
 
+// Identifies the device connected to the probes and measures it. The result record is filled in and its flag returned.
+byte identify( Result &DUT, bool Use_Rh )
+{
+    unsigned long start = millis();
+
+    DUT.clear();
+    Budget_Start(attr::Budget); // Shared by all the phases, see budget.cpp
+    Rescanned = 0;
+    Temperature_Update(); // The compensated values read it from attr::Thermal
+    DUT.Flag = identify_device(DUT, Use_Rh);
+    DUT.Partial = Budget_End();
+    DUT.Profile = attr::Profile.Id;
+    DUT.Elapsed = millis() - start;
+
+    return DUT.Flag;
+}
+
 #undef IDENTIFY_CPP
\ No newline at end of file
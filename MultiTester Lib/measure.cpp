@@ -4,7 +4,46 @@
 #include "config.h"
 #include "functions.h"
 
+// Probe of the table with the given analog pin, 0 if there is none.
+const Probe *Probe_By_ID(byte ID)
+{
+    for(byte p = 0; p < PROBE_COUNT; p++)
+    {
+        if(Probes[p]->ID == ID){ return Probes[p]; }
+    }
+    return 0;
+}
 
+// Moves to the next assignment of roles to probes, in lexicographic order of the probe indices.
+bool Role_Map::next()
+{
+    for(int8_t r = Roles - 1; r >= 0; r--)
+    {
+        // Next probe for role r that is not taken by the roles before it
+        for(byte p = Index[r] + 1; p < PROBE_COUNT; p++)
+        {
+            bool taken = 0;
+            for(byte q = 0; q < r; q++){ taken |= (Index[q] == p); }
+            if(taken){ continue; }
+
+            Index[r] = p;
+            for(byte s = r + 1; s < Roles; s++) // The following roles restart from the lowest free probes
+            {
+                Index[s] = 0;
+                for(bool busy = 1; busy; )
+                {
+                    busy = 0;
+                    for(byte q = 0; q < s; q++)
+                    {
+                        if(Index[q] == Index[s]){ Index[s] ++; busy = 1; }
+                    }
+                }
+            }
+            return 1;
+        }
+    }
+    return 0;
+}
 
 /*
  * "n" is the number of measurements, analogPin is the pin where we are measuring on.
@@ -29,14 +68,20 @@ float Resistance_Measure(int RshuntID, int Vcc_ID ,float Rshunt, const int analo
     // We will work over the following variable, overwriting it with our calculations
     float Value = 0;
 
-    for(int j=0; j<100; j++)
+    // As many of the samples as the time budget allows, one at least
+    unsigned int Sample_ms = ignore_internal ? 11 : 1;
+    unsigned int Samples = Budget_ms((unsigned long) attr::Profile.Samples * Sample_ms) / Sample_ms;
+    if(Samples < attr::Profile.Samples){ Budget_Partial(PARTIAL_SAMPLES); }
+    if(!Samples){ Samples = 1; }
+
+    for(unsigned int j=0; j<Samples; j++)
     {
         Value += analogRead(analogPin);
         delay(1);
         if(ignore_internal){delay(10);}
     }
     Value /= 1023; // 10 bit ADC
-    Value /= 100;    // Averaging
+    Value /= Samples;    // Averaging
 
     if(inverted){Value = 5-Value;} // In case the resistor configuration is inverted ( 5V - Rshunt - R - 0 )
 
@@ -62,6 +107,30 @@ float Resistance_Measure(int RshuntID, int Vcc_ID ,float Rshunt, const int analo
     return Value;
 }
 
+// Scales a capacitance in pF to the prefix it is reported with, which goes to DUT.Power.
+static float capacitance_prefix(Result &DUT, float C)
+{
+    if (C > 1000000)
+    { 
+        DUT.Power = 'u';
+        C /= 1000000;
+    }
+    else if ( C > 1000)
+    { 
+        DUT.Power = 'n';
+        C /= 1000;  
+    }
+    else
+    { 
+        DUT.Power = 'p'; 
+    }
+
+    if(C>400){ C = round(C/10)*10;}
+    else if(C>50){C = round(C); }
+
+    return C; 
+}
+
 /* 
  * Computing Capacitance, we have precalculated the logarithm, as everything should be known.
  * This is the result from the equation of a capacitor discharging through a resistance:
@@ -71,9 +140,9 @@ float Resistance_Measure(int RshuntID, int Vcc_ID ,float Rshunt, const int analo
  * And we have measured the time it takes for the system to discharge to 1.1V (the bandgap reference).
  * 
  */
-float Capacitance_Measure(float Rshunt, unsigned long t, bool Is_Big)
+float Capacitance_Measure(Result &DUT, float Rshunt, unsigned long t, bool Is_Big)
 {
-    static const float factor = 0.6604462612; // 1/(log(Vref/V0)), with V_ref = 1.1V and V0 = 5V
+    const float factor = 1 / log(5 / BANDGAP_V); // 1/(log(Vref/V0)), with V_ref = 1.1V and V0 = 5V
     float C = 0;
     
     // C = (t/R) * (1/[log(Vref/V0)]) From the equation of a capacitor discharge.
@@ -86,26 +155,217 @@ float Capacitance_Measure(float Rshunt, unsigned long t, bool Is_Big)
         C = factor * t / Rshunt; 
     }
 
-    // Prefix Assignment and Rescaling, given that t is in ns and R_shunt in kOhms
-    if (C > 1000000)
-    { 
-        attr::Capacitor.Power = 'u';
-        C /= 1000000;
+    return capacitance_prefix(DUT, C); // pF, given that t is in ns and R_shunt in kOhms
+}
+
+// Capacitance of a CAPACITOR_FLAG result in Farads, from its value and prefix.
+float Capacitance_F(const Result &DUT)
+{
+    float C = DUT.Value[V_CAPACITANCE];
+    switch (DUT.Power)
+    {
+        case 'u': return C * 1e-6;
+        case 'n': return C * 1e-9;
+        case 'p': return C * 1e-12;
     }
-    else if ( C > 1000)
-    { 
-        attr::Capacitor.Power = 'n';
-        C /= 1000;  
+    return C;
+}
+
+/*
+ * Estimate of tau from the falls d1, d2 between readings at t, 2t and 4t. They are in the ratio e^-x (1 + e^-x),
+ * x = t / tau, whatever level the curve heads for. A ratio of 2 or more is a straight line within the readings.
+ */
+static float tau_from_falls(unsigned long t, int d1, int d2)
+{
+    float rho = (float) d2 / d1;
+    if(rho >= 2){ return INFINITY; }
+
+    float u = (sqrt(1 + 4 * rho) - 1) / 2; // e^-x
+    return -(float) t / log(u);
+}
+
+/*
+ * Shape of the charge curve of a pair, telling a capacitor with a resistor across it (bleeder, leaky part) from a
+ * plain one before it is timed. With the capacitor empty, probe A is driven HIGH and probe B pulled LOW through
+ * its Rl, and B is read at times doubling from CAP_MODEL_T0_US. The current charges C and flows through Rp, so the
+ * node falls from the divider of the pins to the DC divider with Rp:
+ *
+ *      V_B(t) = V_inf + (V_top - V_inf) exp(-t / tau)      V_inf = 5V R_B / (Rp + R_A + R_B)
+ *                                                          tau = C (Rp || (R_A + R_B))
+ *
+ * with R_A = Ri_H and R_B = Rl + Ri_L. A fall settling on a level above the noise gives Rp from the level, and C
+ * from tau (least squares line through the log of the excess over the level, anchored at V_top).
+ *
+ * A large capacitor would only be filled here to be drained again before its timing, so the sampling stops as soon
+ * as three falls in a row above the noise give a tau too long to settle in the time left (see tau_from_falls).
+ * Returns:
+ *
+ *  CHARGE_RC           Both values are in DUT, C with its prefix and Rp in kOhms
+ *  CHARGE_RESISTIVE    No fall, and a DC path low enough for CapacitorTMeasure never to reach the bandgap
+ *  CHARGE_CAPACITOR    Anything else (emptied, still falling), to be timed as a capacitor
+ *  CHARGE_TIMEOUT      The pair could not be discharged afterwards, the budget is spent
+ */
+byte Charge_Model(Result &DUT, const Probe &A, const Probe &B)
+{
+    const float R_A = INTERNAL_R_HIGH;
+    const float R_B = B.Rl_val() + INTERNAL_R_LOW;
+    const float V_top = 1023 * R_B / (R_A + R_B);
+
+    unsigned long t[CAP_MODEL_SAMPLES]; // us
+    int V[CAP_MODEL_SAMPLES];
+    byte n = 0;
+    byte slow = 0; // Falls in a row too slow to settle
+    bool settled = 0;
+
+    const unsigned long span_ms = ((unsigned long) CAP_MODEL_T0_US << (CAP_MODEL_SAMPLES - 1)) / 1000 + 1; // Up to the last sample
+    const unsigned long allowed_us = Budget_ms(span_ms) * 1000;
+    const unsigned long window_us = min(allowed_us, span_ms * 1000);
+
+    pinMode(B.ID, INPUT);
+    pinMode(B.Rl, OUTPUT);
+    digitalWrite(B.Rl, LOW);
+    pinMode(A.ID, OUTPUT);
+
+    unsigned long start = micros();
+    digitalWrite(A.ID, HIGH);
+    for(unsigned long next = CAP_MODEL_T0_US; n < CAP_MODEL_SAMPLES; next *= 2)
+    {
+        if(next > allowed_us){ Budget_Partial(PARTIAL_SAMPLES); break; } // Out of time, left to CapacitorTMeasure
+        while(micros() - start < next){}
+        t[n] = micros() - start;
+        V[n] = analogRead(B.ID);
+        n ++;
+
+        if(V[n-1] <= CAP_MODEL_NOISE_LSB){ break; } // Emptied, nothing across it
+        if(n >= 3 && abs(V[n-1] - V[n-2]) <= CAP_MODEL_NOISE_LSB && abs(V[n-2] - V[n-3]) <= CAP_MODEL_NOISE_LSB)
+        {
+            settled = 1; // Flat over the last two intervals, each as long as all the time before
+            break;
+        }
+
+        int d1 = (n >= 3) ? V[n-3] - V[n-2] : 0;
+        int d2 = (n >= 3) ? V[n-2] - V[n-1] : 0;
+        if(d1 > CAP_MODEL_NOISE_LSB && d2 > CAP_MODEL_NOISE_LSB
+           && tau_from_falls(t[n-3], d1, d2) * CAP_MODEL_SETTLE_TAU > window_us)
+        {
+            if(++ slow >= 2){ break; } // Left to CapacitorTMeasure, with the little charge it took so far
+        }
+        else { slow = 0; }
     }
-    else
-    { 
-        attr::Capacitor.Power = 'p'; 
+
+    digitalWrite(A.ID, LOW);
+    pinMode(A.ID, INPUT);
+    pinMode(A.Rl, OUTPUT);
+    digitalWrite(A.Rl, LOW);
+    bool timeout = wait_discharge(A.ID, B.ID, B.ID);
+    pinMode(A.Rl, INPUT);
+    pinMode(B.Rl, INPUT);
+
+    if(timeout){ return CHARGE_TIMEOUT; }
+    if(!settled){ return CHARGE_CAPACITOR; }
+
+    float V_inf = V[n-1];
+    float Rp = R_B * 1023 / V_inf - R_A - R_B; // Ohms
+
+    if(V[0] - V_inf <= 2 * CAP_MODEL_NOISE_LSB || Rp <= 0) // No fall: a resistor, inductor or junction
+    {
+        // Timed through Rm (R_Mode 1) the node would stay above the bandgap below this
+        float R_Bm = B.Rm_val() * 1000 + INTERNAL_R_LOW;
+        float R_Am = A.Rl_val() + INTERNAL_R_HIGH;
+        return (Rp < R_Bm * 5 / BANDGAP_V - R_Am - R_Bm) ? CHARGE_RESISTIVE : CHARGE_CAPACITOR;
     }
 
-    if(C>400){ C = round(C/10)*10;}
-    else if(C>50){C = round(C); }
+    float Sx = 0, Sy = log(V_top - V_inf), Sxx = 0, Sxy = 0; // Anchor at t = 0
+    byte m = 1;
+    for(byte k = 0; k < n; k++)
+    {
+        if(V[k] - V_inf <= 2 * CAP_MODEL_NOISE_LSB){ continue; } // Settled samples say nothing of tau
+        float x = t[k], y = log(V[k] - V_inf);
+        Sx += x; Sy += y; Sxx += x * x; Sxy += x * y;
+        m ++;
+    }
+    float slope = (m * Sxy - Sx * Sy) / (m * Sxx - Sx * Sx); // -1 / tau
+    if(!(slope < 0)){ return CHARGE_CAPACITOR; }
 
-    return C; 
+    float R_th = Rp * (R_A + R_B) / (Rp + R_A + R_B);
+    DUT.Value[V_CAPACITANCE] = capacitance_prefix(DUT, -1e6 / (slope * R_th)); // us / Ohms = uF, to pF
+    DUT.Value[V_R_PARALLEL] = Rp / 1000;
+    return CHARGE_RC;
+}
+
+/*
+ * Small capacitors, below the range of CapacitorTMeasure. The node of probe b is charged from 0V through its Rh
+ * (677k) with probe a held at GND, and Timer 1 captures it crossing the bandgap:
+ *
+ *      t = (Rh + Ri_H) (C + C_stray) ln(5V / (5V - 1.1V))
+ *
+ * One clock is 0.37 pF, and the charge is repeated as many times as fit in SMALLCAP_BUDGET_US (SMALLCAP_MAX_CYCLES
+ * at most) to average the capture jitter, so the time per part does not grow with the resolution. C_stray, the
+ * capacitance the node sees with nothing inserted (probe leads, pin, and the offset of the timing), is stored in
+ * EEPROM per ordered pair of probes by Calibrate_Stray().
+ */
+static float node_pF(byte a, byte b)
+{
+    const Probe &A = *Probes[a];
+    const Probe &B = *Probes[b];
+
+    pinMode(A.ID, OUTPUT);
+    digitalWrite(A.ID, LOW);
+
+    unsigned long time = 0;
+    byte Tflag = ChargeTMeasure(B, SHUNT_H, 1, 1, &time);
+    if(Tflag != 10)
+    {
+        unsigned long cycles = SMALLCAP_BUDGET_US * 1000UL / (time + 20000); // 20 us of discharge and set up per cycle
+        cycles = constrain(cycles, 1, SMALLCAP_MAX_CYCLES);
+        if(cycles > 1){ Tflag = ChargeTMeasure(B, SHUNT_H, cycles, 1, &time); }
+    }
+
+    digitalWrite(A.ID, LOW);
+    pinMode(A.ID, INPUT);
+    if(Tflag == 10){ return -1; } // Never charged: a resistor or a forward junction to GND
+
+    const float factor = 1 / log(5 / (5 - BANDGAP_V)); // 1/ln(V0/(V0 - Vref)), with V_ref = 1.1V and V0 = 5V
+    return factor * time / (B.Rh_val() * 1000 + INTERNAL_R_HIGH) * 1000; // ns / Ohms = nF, to pF
+}
+
+// Stored stray capacitance seen by probe b with probe a at GND (pF), 0 if never calibrated.
+float Stray_pF(byte a, byte b)
+{
+    float C = eeprom_read_float((const float *) (EEPROM_STRAY + (a * PROBE_COUNT + b) * sizeof(float)));
+    return isnan(C) ? 0 : C; // Erased EEPROM reads as NaN
+}
+
+// Measures and stores the stray capacitance of every ordered pair of probes, to be run with nothing inserted.
+void Calibrate_Stray()
+{
+    Role_Map Pair(2);
+    do
+    {
+        float C = node_pF(Pair.Index[ROLE_A], Pair.Index[ROLE_B]);
+        eeprom_update_float((float *) (EEPROM_STRAY + (Pair.Index[ROLE_A] * PROBE_COUNT + Pair.Index[ROLE_B]) * sizeof(float)), (C < 0) ? 0 : C);
+    } while(Pair.next());
+}
+
+/*
+ * Capacitance between probes a and b (indices in the table) in pF, the stray capacitance removed. Charged both ways
+ * round, as a reverse biased junction also holds a few pF but conducts the other way. Returns 0 if there is no
+ * capacitor: one way not charging, the two ways disagreeing, below SMALLCAP_MIN_PF or above SMALLCAP_MAX_PF.
+ */
+float Small_Capacitance(byte a, byte b)
+{
+    float C_ab = node_pF(a, b);
+    if(C_ab < 0){ return 0; }
+    float C_ba = node_pF(b, a);
+    if(C_ba < 0){ return 0; }
+
+    C_ab -= Stray_pF(a, b);
+    C_ba -= Stray_pF(b, a);
+    if(fabs(C_ab - C_ba) > SMALLCAP_MATCH_PCT / 100.0 * max(C_ab, C_ba) + SMALLCAP_MIN_PF){ return 0; }
+
+    float C = (C_ab + C_ba) / 2;
+    if(C < SMALLCAP_MIN_PF || C > SMALLCAP_MAX_PF){ return 0; }
+    return round(C * 10) / 10; // 0.1 pF
 }
 
 
@@ -135,7 +395,7 @@ float Inductance_Measure(float Rshunt, float R_inductor, unsigned long t)
 
     float L = 0;
     float R = Rshunt + Rih + Ril + R_inductor;
-    float I_ratio = 0.22 * R / (Ril + Rshunt); // I(t)/I0 = [Vref/(Ril + Rshunt)] / [5/R], Vref = 1.1V, Vcc = 5V
+    float I_ratio = BANDGAP_V / 5 * R / (Ril + Rshunt); // I(t)/I0 = [Vref/(Ril + Rshunt)] / [5/R], Vref = 1.1V, Vcc = 5V
 
     float num = t*R/1000;
 
@@ -144,118 +404,596 @@ float Inductance_Measure(float Rshunt, float R_inductor, unsigned long t)
     return L;
 }
 
-float Diode_Measure(bool Low_I, byte Anode, byte Cathode)
+/*
+ * Small inductors (1 - 50 uH), rung against the reference capacitor (see ResonanceTMeasure). Probe A must be
+ * LC_PROBE, the one whose Rm pin is AIN0. The crossings give the damped period T, the ringing then lasts until its
+ * amplitude, I0 sqrt(L/C) at first, decays to the comparator offset, which gives the decay rate:
+ *
+ *      alpha = ln(I0 sqrt(L/C) / LC_COMPARATOR_MV) / (edges T),    w0^2 = (2 pi / T)^2 + alpha^2
+ *
+ *      L = 1 / (w0^2 C),   Q = w0 / (2 alpha),   R = 2 alpha L
+ *
+ * The loop resistance besides the coil (LC_LOOP_R) is taken off R for R_parasit. Q is the rougher of the two, from
+ * the count of crossings only. Returns 1 if nothing rang.
+ */
+bool Resonance_Measure(Result &DUT, const Probe &A, const Probe &B)
 {
-    byte R_pullup = 0;
-    byte R_val = 0;
+    if(!LC_REF_PIN || &A != Probes[LC_PROBE]){ return 1; }
+
+    unsigned int t[LC_MAX_EDGES];
+    byte edges = 0;
+    if(ResonanceTMeasure(A, B, t, LC_MAX_EDGES, &edges)){ return 1; }
 
-    if(Anode == P1.ID)
+    byte stored = min(edges, (byte) LC_MAX_EDGES);
+    unsigned long ticks = 0;
+    for(byte i = 1; i < stored; i++){ ticks += (unsigned int) (t[i] - t[i - 1]); } // Timer wraps every 4 ms
+
+    const float C = LC_REF_PF * 1e-12;
+    float T = ticks / (stored - 1) / 16e6;                         // s
+    float w0 = 2 * PI / T;
+    float I0 = 5.0 / (A.Rl_val() + INTERNAL_R_HIGH + INTERNAL_R_LOW); // A
+    float alpha = 0;
+
+    for(byte i = 0; i < 3; i++) // Damping and L depend on each other, a few rounds settle them
     {
-        R_pullup = P1.Rl;
-        R_val = P1.Rl_val + INTERNAL_R_LOW + INTERNAL_R_HIGH;
+        float L = 1 / (w0 * w0 * C);
+        float A0 = I0 * sqrt(L / C) * 1000;                        // mV
+        alpha = (A0 > LC_COMPARATOR_MV) ? log(A0 / LC_COMPARATOR_MV) / (edges * T) : 0;
+        w0 = sqrt(pow(2 * PI / T, 2) + alpha * alpha);
+    }
 
-        if(Low_I)
-        {
-            R_pullup = P1.Rh;
-            R_val = P1.Rh_val;
-        }
+    float L = 1 / (w0 * w0 * C);
+    DUT.Value[V_INDUCTANCE] = L * 1e6;                             // uH
+    DUT.Value[V_R_PARASIT] = max(2 * alpha * L - LC_LOOP_R, 0.0);
+    DUT.Value[V_Q] = alpha ? w0 / (2 * alpha) : 0;
+    DUT.Power = 'u';
+    return 0;
+}
+
+/*
+ * L and R together from the current rise of a single pulse (see InductorWaveform), sampled every "period_us" as
+ * the voltage across R_sense (Ohms). For I(t) = I0 (1 - exp(-t R / L)), whenever the pulse started, samples a
+ * period apart follow
+ *
+ *      V[k+1] = q V[k] + (1 - q) V_inf,        q = exp(-period R / L)
+ *
+ * which is linear in V[k]: q and V_inf come from a least squares line, then R = 5V / I0 and L = R tau.
+ * R includes the shunt and the pin resistances, which are taken off for R_parasit. Returns 1 if the samples do not
+ * show an exponential rise.
+ */
+bool Inductance_Fit(Result &DUT, const unsigned int *V, byte n, unsigned int period_us, float R_sense)
+{
+    float Sx = 0, Sy = 0, Sxx = 0, Sxy = 0;
+    byte m = n - 1;
+
+    for(byte k = 0; k < m; k++)
+    {
+        float x = V[k], y = V[k + 1];
+        Sx += x; Sy += y; Sxx += x * x; Sxy += x * y;
     }
-    else if(Anode == P2.ID)
+
+    float det = m * Sxx - Sx * Sx;
+    if(det <= 0){ return 1; } // Flat, nothing rose
+
+    float q = (m * Sxy - Sx * Sy) / det;
+    if(q <= 0 || q >= 1){ return 1; }
+
+    float V_inf = (Sy - q * Sx) / m / (1 - q) * 5000 / 1023;   // mV
+    if(V_inf <= 0){ return 1; }
+
+    float R = 5000 / (V_inf / R_sense);                         // mV / mA = Ohms, the whole loop
+    float tau = -(float) period_us / log(q);                    // us
+
+    DUT.Value[V_INDUCTANCE] = tau * R;                          // us * Ohms = uH
+    DUT.Value[V_R_PARASIT] = max(R - R_sense - INTERNAL_R_HIGH, 0.0);
+    return 0;
+}
+
+// Pin and value (Ohms) of one of the shunt resistors of a probe, SHUNT_NONE for the probe pin itself.
+byte Shunt_Pin(const Probe &P, byte Size, float *R)
+{
+    switch (Size)
     {
-        R_pullup = P2.Rl;
-        R_val = P2.Rl_val + INTERNAL_R_LOW + INTERNAL_R_HIGH;
+        case SHUNT_L: *R = P.Rl_val();        return P.Rl;
+        case SHUNT_M: *R = P.Rm_val() * 1000; return P.Rm; // Stored in kOhms
+        case SHUNT_H: *R = P.Rh_val() * 1000; return P.Rh;
+        default:      *R = 0;                 return P.ID;
+    }
+}
 
-        if(Low_I)
-        {
-            R_pullup = P2.Rh;
-            R_val = P2.Rh_val;
-        }
+/*
+ * Predicted uncertainty (Ohms) of a resistance R measured by Resistance_Measure against a shunt Rs (Ohms).
+ * The divider reads x = Rs' / (Rs' + R + Rih), with Rs' = Rs + Ril, so an error dx of the reading gives
+ *
+ *      dR = (Rs' + R + Rih)^2 / Rs' * dx
+ *
+ * smallest for a shunt near R. The reading errors are the ADC noise and quantisation (RES_NOISE_LSB, averaged over
+ * attr::Profile.Samples) and the pin leakage through the node impedance. To these add the internal resistances (known to
+ * RES_INTERNAL_TOL, or the bias (Rs Rih - R Ril) / Rs' of leaving them out on the kOhm ranges) and the shunt
+ * tolerance. A reading within a LSB of either rail cannot be inverted: infinite.
+ */
+static float range_uncertainty(float R, float Rs, bool ignore_internal)
+{
+    float Rs_tot = Rs + INTERNAL_R_LOW;
+    float R_tot = Rs_tot + R + INTERNAL_R_HIGH;
+    float x = Rs_tot / R_tot;
+
+    if(x * 1023 < 1 || x * 1023 > 1022){ return INFINITY; }
+
+    float dx_adc = sqrt((1.0/12 + sq(RES_NOISE_LSB)) / attr::Profile.Samples) / 1023;
+    float dx_leak = RES_LEAKAGE_NA * 1e-9 * (Rs_tot * (R + INTERNAL_R_HIGH) / R_tot) / 5;
+    float dR_read = R_tot * R_tot / Rs_tot * sqrt(sq(dx_adc) + sq(dx_leak));
+    float dR_int = ignore_internal ? fabs(Rs * INTERNAL_R_HIGH - R * INTERNAL_R_LOW) / Rs_tot : RES_INTERNAL_TOL;
+
+    return sqrt(sq(dR_read) + sq(dR_int) + sq(R * RES_SHUNT_TOL));
+}
+
+/*
+ * Measures the resistor between A and B (A on the shunt side) with a single pass of Resistance_Measure, on the
+ * shunt of A predicted to give the lowest uncertainty for the coarse value R_coarse (Ohms). Without one (negative)
+ * it is taken from a single reading through Rm. The value goes to DUT with its uncertainty, in Ohms through Rl and
+ * kOhms otherwise. Returns the shunt used.
+ */
+byte Resistance_Auto(Result &DUT, const Probe &A, const Probe &B, float R_coarse)
+{
+    float Rs = 0;
+    byte Shunt = 0;
+
+    if(R_coarse < 0)
+    {
+        Shunt = Shunt_Pin(A, SHUNT_M, &Rs);
+        pinMode(A.ID, INPUT);
+        pinMode(Shunt, OUTPUT);
+        pinMode(B.ID, OUTPUT);
+        digitalWrite(Shunt, LOW);
+        digitalWrite(B.ID, HIGH);
+        delay(10);
+
+        analogRead(A.ID); // Discarding the first measure, high impedances need it
+        int ADC_Reading = analogRead(A.ID);
+
+        digitalWrite(B.ID, LOW);
+        pinMode(Shunt, INPUT);
+        pinMode(B.ID, INPUT);
+
+        R_coarse = ADC_Reading ? Rs * 1023.0 / ADC_Reading - Rs : INFINITY;
     }
-    else if(Anode == P3.ID)
+
+    byte Best = SHUNT_L;
+    float Best_dR = INFINITY;
+    for(byte s = SHUNT_L; s <= SHUNT_H; s++)
     {
-        R_pullup = P3.Rl;
-        R_val = P3.Rl_val + INTERNAL_R_LOW + INTERNAL_R_HIGH;
+        Shunt_Pin(A, s, &Rs);
+        float dR = range_uncertainty(R_coarse, Rs, s != SHUNT_L);
+        if(dR <= Best_dR){ Best = s; Best_dR = dR; } // Rh if none can read it
+    }
 
-        if(Low_I)
-        {
-            R_pullup = P3.Rh;
-            R_val = P3.Rh_val;
-        }
+    Shunt = Shunt_Pin(A, Best, &Rs);
+    bool kOhms = (Best != SHUNT_L); // The Rm and Rh values are stored in kOhms, and those passes ignore the internal R
+    float Scale = kOhms ? 1000 : 1;
+
+    float R = Resistance_Measure(Shunt, B.ID, Rs / Scale, A.ID, 0, kOhms);
+    float dR = range_uncertainty(R * Scale, Rs, kOhms);
+
+    DUT.Value[V_RESISTANCE] = R;
+    DUT.Uncertainty = isinf(dR) ? 0 : dR / Scale;
+    DUT.Power = kOhms ? 'k' : ' ';
+
+    return Best;
+}
+
+// Averages the Oversample readings of the profile, which adds 2 bits of resolution for every 4x (result in mV).
+static float oversampled_mV(byte pin)
+{
+    analogRead(pin); // Discarding the first measure, after switching ports it may be unreliable
+    unsigned long ADC_Reading = 0;
+    const byte n = attr::Profile.Oversample;
+
+    for(byte i = 0; i < n; i++)
+    {
+        ADC_Reading += analogRead(pin);
     }
-    else{ return -1; } // Error
+    return ADC_Reading * 5000.0 / (1023.0 * n);
+}
+
+/*
+ * One operating point of a diode: the anode pulled up through one of its shunts, the cathode grounded directly
+ * (SHUNT_NONE) or through one of its own. Returns the voltage across the diode (mV) and the current in *I (A).
+ */
+float Diode_Point(const Probe &Anode, byte Anode_Shunt, const Probe &Cathode, byte Cathode_Shunt, float *I)
+{
+    float Ra = 0;
+    float Rk = 0;
+    byte R_pullup = Shunt_Pin(Anode, Anode_Shunt, &Ra);
+    byte R_pulldown = Shunt_Pin(Cathode, Cathode_Shunt, &Rk);
 
     // Setting up the probes for measurement
-    pinMode(Anode, INPUT);
-    pinMode(Cathode, OUTPUT);
+    pinMode(Anode.ID, INPUT);
+    pinMode(Cathode.ID, INPUT);
+    pinMode(R_pulldown, OUTPUT);
     pinMode(R_pullup, OUTPUT);
     
-    digitalWrite(Cathode, LOW);
+    digitalWrite(R_pulldown, LOW);
     digitalWrite(R_pullup, HIGH);
-    delay(10);
+    delay(DIODE_SETTLE_MS);
 
-    float Voltage = 0;
-    unsigned long ADC_Reading = 0;
+    float Va = oversampled_mV(Anode.ID);
+    float Vk = (Cathode_Shunt == SHUNT_NONE) ? 0 : oversampled_mV(Cathode.ID);
 
-    for(int i = 0; i < 100; i++)
+    digitalWrite(R_pullup, LOW);
+    pinMode(R_pullup, INPUT);
+    pinMode(R_pulldown, INPUT);
+
+    *I = (5000 - Va) / (Ra + INTERNAL_R_HIGH) / 1000; // mV / Ohms = mA, to A
+    if(*I < 0){ *I = 0; } // Sanity check
+
+    if(Cathode_Shunt == SHUNT_NONE){ Vk = *I * 1000 * INTERNAL_R_LOW; } // Accounting for Internal Resistances
+
+    return Va - Vk;
+}
+
+/*
+ * Diode characterisation. The forward point is taken with every source impedance available, the anode pulled
+ * up through its Rl, Rm or Rh and the cathode grounded directly or through its resistor of the same size, about
+ * three decades of current. The Shockley equation with a series resistance,
+ *
+ *      V = n Vt ln(I/Is) + I Rs
+ *
+ * is linear in (n Vt, -n Vt ln(Is), Rs) against ln(I), 1 and I, so it is fitted by least squares in one go.
+ * The kind comes from the drop the fit gives at 1 mA, and a reverse point through Rl finds Zeners below 5 V.
+ */
+void Diode_Sweep(Result &DUT, const Probe &Anode, const Probe &Cathode)
+{
+    static const byte Points[][2] = // Anode and cathode shunts, highest current first
     {
-        ADC_Reading += analogRead(Anode);
+        {SHUNT_L, SHUNT_NONE}, {SHUNT_L, SHUNT_L},
+        {SHUNT_M, SHUNT_NONE}, {SHUNT_M, SHUNT_M},
+        {SHUNT_H, SHUNT_NONE}, {SHUNT_H, SHUNT_H},
+    };
+    float N[3][4] = {{0,0,0,0}, {0,0,0,0}, {0,0,0,0}}; // Normal equations, augmented with the right hand side
+    byte fitted = 0;
+
+    DUT.Pins[ROLE_ANODE]   = Anode.ID;
+    DUT.Pins[ROLE_CATHODE] = Cathode.ID;
+
+    for(byte k = 0; k < sizeof(Points)/sizeof(Points[0]); k++)
+    {
+        float I = 0;
+        float V = Diode_Point(Anode, Points[k][0], Cathode, Points[k][1], &I);
+
+        float V_25 = Thermal_25C_mV(V, DIODE_TC_MV); // Reported at 25 C, the fit takes the drops as measured
+        if(k == 0){ DUT.Value[V_VDH] = round(V_25/10)*10; DUT.Value[V_IH] = I * 1e3; } // Same points as the old two point measure
+        if(k == 4){ DUT.Value[V_VDL] = round(V_25/10)*10; DUT.Value[V_IL] = I * 1e6; }
+
+        if(I < DIODE_MIN_I || V <= 0){ continue; } // Below the resolution of the ADC
+
+        float x[3] = {(float)log(I), 1, I};
+        for(byte r = 0; r < 3; r++)
+        {
+            for(byte c = 0; c < 3; c++){ N[r][c] += x[r]*x[c]; }
+            N[r][3] += x[r] * V / 1000;
+        }
+        fitted ++;
     }
 
-    digitalWrite(R_pullup, LOW);
-    pinMode(Cathode, INPUT);
-    pinMode(R_pullup, INPUT);
+    // Reverse point, only a Zener conducts
+    float Ir = 0;
+    float Vr = Diode_Point(Cathode, SHUNT_L, Anode, SHUNT_NONE, &Ir);
+    bool Zener = (Vr < ZENER_MAX_MV && Ir > DIODE_MIN_I);
+    DUT.Value[V_VZ] = Zener ? round(Vr/10)*10 : 0;
+
+    if(fitted < 3){ return; } // Not enough points for the model
 
-    Voltage = 5*ADC_Reading/102.30; // 102.30 = 1.023*100 (ADC conversion to mV and average)
-    float Current = 0;
-    // Storing Intensity values
-    if(Low_I)
+    // Gaussian elimination, the matrix is symmetric and positive definite
+    float abc[3];
+    byte unknowns = 3;
+    for(byte pass = 0; pass < 2; pass++)
     {
-        Current = (5000-Voltage)/R_val;
-        attr::Diode.HI_Value = Current;
+        float M[3][4];
+        memcpy(M, N, sizeof(M));
+
+        for(byte p = 0; p < unknowns; p++)
+        {
+            for(byte r = p + 1; r < unknowns; r++)
+            {
+                float f = M[r][p] / M[p][p];
+                for(byte c = p; c < 4; c++){ M[r][c] -= f * M[p][c]; }
+            }
+        }
+        for(int8_t r = unknowns - 1; r >= 0; r--)
+        {
+            float sum = M[r][3];
+            for(byte c = r + 1; c < unknowns; c++){ sum -= M[r][c] * abc[c]; }
+            abc[r] = sum / M[r][r];
+        }
+
+        if(unknowns == 2 || abc[2] >= 0){ break; }
+        unknowns = 2; abc[2] = 0; // A negative series resistance is noise, fitting the ideal diode instead
     }
-    else
+
+    float nVt = abc[0];
+    if(nVt <= 0){ return; } // Nonsense fit
+
+    DUT.Value[V_N]  = nVt / THERMAL_VOLTAGE;
+    DUT.Value[V_IS] = Thermal_25C_Is(exp(-abc[1] / nVt), DUT.Value[V_N]);
+    DUT.Value[V_RS] = abc[2];
+
+    float V_1mA = nVt * log(1e-3) + abc[1] + abc[2] * 1e-3;
+
+    if      (Zener)                     { DUT.Kind = KIND_ZENER; }
+    else if (V_1mA > LED_MIN_V)         { DUT.Kind = KIND_LED; }
+    else if (V_1mA < SCHOTTKY_MAX_V)    { DUT.Kind = KIND_SCHOTTKY; }
+    else                                { DUT.Kind = KIND_SILICON; }
+}
+
+// Drives probe "high" HIGH and the others LOW, all through the given shunt, and reads every probe (mV).
+static void network_state(byte high, byte Size, float V[3])
+{
+    for(byte p = 0; p < 3; p++)
     {
-        Current = (5000-Voltage)/(R_val); 
-        Voltage -= Current*INTERNAL_R_LOW; // Accountign for Internal Resistances
-        attr::Diode.LI_Value = Current;
+        float R = 0;
+        byte Pin = Shunt_Pin(*Probes[p], Size, &R);
+        pinMode(Probes[p]->ID, INPUT);
+        pinMode(Pin, OUTPUT);
+        digitalWrite(Pin, p == high);
     }
+    delay(RNET_SETTLE_MS);
+
+    for(byte p = 0; p < 3; p++){ V[p] = oversampled_mV(Probes[p]->ID); }
 
-    return round(Voltage/10)*10;
+    for(byte p = 0; p < 3; p++)
+    {
+        float R = 0;
+        byte Pin = Shunt_Pin(*Probes[p], Size, &R);
+        digitalWrite(Pin, LOW);
+        pinMode(Pin, INPUT);
+    }
 }
 
-// Bridge between BJT measures and the Semic class
-void Assign_BJT(float VDrop[2], unsigned int Beta[2], float Ibase[2], byte Test1, byte Test2)
+/*
+ * Three terminal resistor network (potentiometer, trimmer, resistor array) across the first three probes.
+ *
+ * Any such network is a triangle of conductances g01, g02, g12 between the probes. Each probe in turn is driven
+ * HIGH through its shunt with the others LOW, and a single acquisition reads the three nodes. The current into
+ * each node is known from its shunt, and is linear in the conductances:
+ *
+ *      I0 = g01 (V0 - V1) + g02 (V0 - V2)     (and likewise for nodes 1 and 2)
+ *
+ * so the 9 equations of the 3 states are solved by least squares. The shunt is chosen from a first reading of
+ * the resistance seen by probe 1 (Rh straight away on the high impedance scan). The triangle is reported as the
+ * equivalent star, the branch from each probe to a common node, which is what a potentiometer is: the wiper has
+ * the smallest branch and the ends the two sides of the track. The wiper goes in the middle of Pins, and its
+ * position is given from the first end if its branch is below RNET_WIPER_RATIO of the track.
+ * Returns 1 if the network cannot be solved.
+ */
+bool RNet_Measure(Result &DUT, bool Use_Rh)
 {
-    if(Beta[1] >= Beta[2])
+    float V[3][3];  // State (probe driven HIGH), probe
+    byte Size = Use_Rh ? SHUNT_H : SHUNT_L;
+
+    if(!Use_Rh) // Coarse reading through Rl: resistance seen from probe 1 against the others in parallel
+    {
+        float Rs = 0;
+        Shunt_Pin(*Probes[0], SHUNT_L, &Rs);
+        network_state(0, SHUNT_L, V[0]);
+        float R_in = (V[0][0] - (V[0][1] + V[0][2]) / 2) / (5000 - V[0][0]) * (Rs + INTERNAL_R_HIGH);
+
+        float Rm = 0, Rh = 0;
+        Shunt_Pin(*Probes[0], SHUNT_M, &Rm);
+        Shunt_Pin(*Probes[0], SHUNT_H, &Rh);
+        if      (R_in > sqrt(Rm * Rh)) { Size = SHUNT_H; } // Geometric middles of the ranges
+        else if (R_in > sqrt(Rs * Rm)) { Size = SHUNT_M; }
+    }
+
+    // Normal equations M g = b of the least squares, g = (g01, g02, g12)
+    static const byte Pair[3][2] = { {0, 1}, {0, 2}, {1, 2} };
+    float M[3][3] = {{0,0,0}, {0,0,0}, {0,0,0}};
+    float b[3] = {0, 0, 0};
+
+    for(byte s = 0; s < 3; s++)
     {
-        attr::Semiconductor.Beta = Beta[1];
-        attr::Semiconductor._V1_ = VDrop[1];    // Base - Emitter Voltage Drop
-        attr::Semiconductor._V2_ = VDrop[2];    // Collector - Base Voltage Drop
-        attr::Semiconductor.I_B = Ibase[1];     // Base Current
+        if(Size != SHUNT_L || s){ network_state(s, Size, V[s]); } // The first state through Rl is already read
 
-        attr::Semiconductor.Collector = Test1;
-        attr::Semiconductor.Emitter   = Test2;
+        for(byte k = 0; k < 3; k++)
+        {
+            float Rs = 0;
+            Shunt_Pin(*Probes[k], Size, &Rs);
+            Rs += (k == s) ? INTERNAL_R_HIGH : INTERNAL_R_LOW;
+            float I = ((k == s ? 5000 : 0) - V[s][k]) / Rs; // Into the network
+
+            float Row[3];
+            for(byte j = 0; j < 3; j++)
+            {
+                if      (Pair[j][0] == k) { Row[j] = V[s][k] - V[s][Pair[j][1]]; }
+                else if (Pair[j][1] == k) { Row[j] = V[s][k] - V[s][Pair[j][0]]; }
+                else                      { Row[j] = 0; }
+            }
+            for(byte i = 0; i < 3; i++)
+            {
+                for(byte j = 0; j < 3; j++){ M[i][j] += Row[i] * Row[j]; }
+                b[i] += Row[i] * I;
+            }
+        }
+    }
 
-        if(Beta[1] == Beta[2]){ Serial.println("Symmetrical BJT"); }
-        else if(Beta[1]/Beta[2] < 2){ Serial.println("Possibly Symmetrical BJT"); }
+    // Cramer's rule
+    float det = M[0][0] * (M[1][1] * M[2][2] - M[1][2] * M[2][1])
+              - M[0][1] * (M[1][0] * M[2][2] - M[1][2] * M[2][0])
+              + M[0][2] * (M[1][0] * M[2][1] - M[1][1] * M[2][0]);
+    if(det == 0){ return 1; }
+
+    float g[3];
+    for(byte j = 0; j < 3; j++)
+    {
+        float A[3][3];
+        memcpy(A, M, sizeof(A));
+        for(byte i = 0; i < 3; i++){ A[i][j] = b[i]; }
+
+        g[j] = (A[0][0] * (A[1][1] * A[2][2] - A[1][2] * A[2][1])
+              - A[0][1] * (A[1][0] * A[2][2] - A[1][2] * A[2][0])
+              + A[0][2] * (A[1][0] * A[2][1] - A[1][1] * A[2][0])) / det;
+        if(g[j] < 0){ g[j] = 0; } // Noise on a branch that is not there (the ends of a potentiometer)
+    }
+
+    // Triangle to star: the branch of a probe is the conductance facing it over the sum of the products
+    float D = g[0] * g[1] + g[0] * g[2] + g[1] * g[2];
+    if(D <= 0){ return 1; }
+    float Branch[3] = { g[2] / D, g[1] / D, g[0] / D }; // Ohms
+
+    byte Wiper = 0;
+    for(byte p = 1; p < 3; p++){ if(Branch[p] < Branch[Wiper]){ Wiper = p; } }
+    byte End_A = (Wiper == 0) ? 1 : 0;
+    byte End_B = 3 - Wiper - End_A;
+
+    float Track = Branch[End_A] + Branch[End_B];
+    float Scale = (Track >= 1000) ? 1000 : 1;
+
+    DUT.Pins[0] = Probes[End_A]->ID;
+    DUT.Pins[1] = Probes[Wiper]->ID;
+    DUT.Pins[2] = Probes[End_B]->ID;
+    DUT.Value[V_RNET_A] = Branch[End_A] / Scale;
+    DUT.Value[V_RNET_W] = Branch[Wiper] / Scale;
+    DUT.Value[V_RNET_B] = Branch[End_B] / Scale;
+    DUT.Power = (Scale > 1) ? 'k' : ' ';
+
+    if(Branch[Wiper] < RNET_WIPER_RATIO * Track)
+    {
+        DUT.Value[V_WIPER] = 100 * Branch[End_A] / Track;
+        DUT.Kind = KIND_POT;
     }
-    else if(Beta[1] < Beta[2])
+    return 0;
+}
+
+/*
+ * Leakage and dielectric absorption of a capacitor result, its positive lead on probe A (ROLE_A).
+ *
+ * Leakage: the capacitor is charged through Rl, then held at 5V through Rh (Rm for leaky parts dropping more than
+ * LEAK_MAX_DROP_MV across Rh). The current through the shunt feeds both the leakage and the capacitor, so over
+ * the time T since the hold started
+ *
+ *      I_leak = mean((5V - Va) / R) - C (Va(T) - Va(0)) / T
+ *
+ * whether the capacitor is still settling or not. The estimate is taken every LEAK_STEP_MS and the test ends
+ * once two of them agree within LEAK_STABLE_PCT, or after "window_ms".
+ *
+ * Dielectric absorption: the capacitor is then shorted through Rl for DA_SHORT_MS (5 time constants at least) and
+ * left open; the voltage it recovers, read until it stops rising or DA_RECOVERY_MS, is given in % of the hold.
+ * Returns 1 if the capacitor does not take a charge.
+ */
+bool Capacitor_Leakage(Result &DUT, unsigned long window_ms)
+{
+    const Probe *A = Probe_By_ID(DUT.Pins[ROLE_A]);
+    const Probe *B = Probe_By_ID(DUT.Pins[ROLE_B]);
+    if(DUT.Flag != CAPACITOR_FLAG || !A || !B){ return 1; }
+
+    float C = Capacitance_F(DUT);
+    unsigned long tau_ms = C * (A->Rl_val() + INTERNAL_R_LOW + INTERNAL_R_HIGH) * 1000; // Through Rl
+
+    pinMode(A->ID, INPUT);
+    pinMode(B->ID, OUTPUT);
+    digitalWrite(B->ID, LOW);
+
+    // Charging through Rl
+    pinMode(A->Rl, OUTPUT);
+    digitalWrite(A->Rl, HIGH);
+    delay(5 * tau_ms + 1);
+
+    byte Size = SHUNT_H;
+    float R = 0;
+    byte Hold = Shunt_Pin(*A, Size, &R);
+    pinMode(Hold, OUTPUT);
+    digitalWrite(Hold, HIGH);
+    pinMode(A->Rl, INPUT);
+
+    // Leakage
+    float V0 = oversampled_mV(A->ID);
+    bool charged = (V0 > LEAK_MIN_MV);
+    float V = V0;
+    float Q = 0;            // Charge through the shunt (mA * ms = uC)
+    float I_last = (5000 - V0) / (R + INTERNAL_R_HIGH);
+    float previous = 0;
+    unsigned long start = millis();
+    unsigned long last = start;
+    unsigned long step = start;
+
+    while(millis() - start < window_ms)
     {
-        attr::Semiconductor.Beta = Beta[2];
-        attr::Semiconductor._V1_ = VDrop[2];    // Base - Emitter Voltage Drop
-        attr::Semiconductor._V2_ = VDrop[1];    // Collector - Base Voltage Drop
-        attr::Semiconductor.I_B = Ibase[2];     // Base Current
+        delay(LEAK_SAMPLE_MS);
+        V = oversampled_mV(A->ID);
+        unsigned long now = millis();
+        float I = (5000 - V) / (R + INTERNAL_R_HIGH);   // mA
+
+        if(5000 - V > LEAK_MAX_DROP_MV && Size == SHUNT_H) // Too leaky for Rh, starting over through Rm
+        {
+            Size = SHUNT_M;
+            pinMode(Hold, INPUT);
+            Hold = Shunt_Pin(*A, Size, &R);
+            pinMode(Hold, OUTPUT);
+            digitalWrite(Hold, HIGH);
+
+            V0 = oversampled_mV(A->ID);
+            I_last = (5000 - V0) / (R + INTERNAL_R_HIGH);
+            Q = 0;
+            start = last = step = millis();
+            continue;
+        }
+        Q += (I + I_last) / 2 * (now - last);
+        I_last = I;
+        last = now;
+
+        if(now - step < LEAK_STEP_MS){ continue; }
+        step = now;
+
+        float T = now - start;                                      // ms
+        float estimate = (Q / T - C * (V - V0) / T * 1000) * 1000;  // mA to uA, C in F times mV / ms is A
+        DUT.Value[V_LEAKAGE] = estimate;
+        if(previous && fabs(estimate - previous) <= fabs(estimate) * LEAK_STABLE_PCT / 100 + LEAK_FLOOR_UA){ break; }
+        previous = estimate;
+    }
+
+    float V_hold = V;
 
-        attr::Semiconductor.Collector = Test2;
-        attr::Semiconductor.Emitter   = Test1;
+    // Dielectric absorption: short, then open and watch the voltage come back
+    pinMode(A->Rl, OUTPUT);
+    digitalWrite(A->Rl, LOW);
+    digitalWrite(Hold, LOW);
+    pinMode(Hold, INPUT);
+    delay(max(5 * tau_ms, (unsigned long) DA_SHORT_MS));
+    pinMode(A->Rl, INPUT);
 
-        if(Beta[2]/Beta[1] < 2){ Serial.println("Possibly Symmetrical BJT");}
+    float peak = 0;
+    start = millis();
+    while(millis() - start < DA_RECOVERY_MS)
+    {
+        delay(DA_SAMPLE_MS);
+        V = oversampled_mV(A->ID);
+        if(V + 2 < peak){ break; } // Falling back through the leakage: the peak is past (2 mV of noise)
+        if(V > peak){ peak = V; }
     }
+    DUT.Value[V_DA] = (V_hold > 0) ? peak / V_hold * 100 : 0;
+
+    // Discharging before leaving
+    pinMode(A->Rl, OUTPUT);
+    digitalWrite(A->Rl, LOW);
+    delay(5 * tau_ms + 1);
+    pinMode(A->Rl, INPUT);
+    digitalWrite(B->ID, LOW);
+    pinMode(B->ID, INPUT);
+
+    return !charged;
 }
 
 // Measures the Amplification Factor and the Characteristic Voltage Drops.
-unsigned int PNP_Beta_Measure(byte Base, byte Collector, byte Emitter, byte Rb, float Rb_val, byte Re, float Re_val)
+unsigned int PNP_Beta_Measure(const Role_Map &BJT, float *Vbe, float *Ib)
 {
+    byte Base = BJT[ROLE_BASE].ID;
+    byte Collector = BJT[ROLE_COLLECTOR].ID;
+    byte Emitter = BJT[ROLE_EMITTER].ID;
+    byte Rb = BJT[ROLE_BASE].Rm;
+    float Rb_val = BJT[ROLE_BASE].Rm_val();
+    byte Re = BJT[ROLE_EMITTER].Rl;
+    float Re_val = BJT[ROLE_EMITTER].Rl_val();
+
     // Setting up the measurement scheme
     
     pinMode(Base, INPUT);
@@ -273,15 +1011,17 @@ unsigned int PNP_Beta_Measure(byte Base, byte Collector, byte Emitter, byte Rb,
     float R_factor = (Rb_val*1000 + INTERNAL_R_LOW) / (INTERNAL_R_HIGH + Re_val); // Rb_val will be in kOhms
     unsigned int ADC_B = 0;
     unsigned int ADC_E = 0;
+    const byte n = attr::Profile.Pair_Samples;
+    const float Full = 1023.0 * n; // Sum of n readings at 5 V
 
-    for(byte i = 0; i<50; i++)
+    for(byte i = 0; i<n; i++)
     {
         ADC_B += analogRead(Base);
     }
     delay(1);
     analogRead(Emitter); // Discarding the first measure, after switching ports it may be unreliable
 
-    for(byte i = 0; i<50; i++)
+    for(byte i = 0; i<n; i++)
     {
         ADC_E += analogRead(Emitter);
     }
@@ -293,26 +1033,33 @@ unsigned int PNP_Beta_Measure(byte Base, byte Collector, byte Emitter, byte Rb,
     pinMode(Rb, INPUT);
     pinMode(Collector, INPUT);
 
-    // Averaging and conversion to V is implicitly done through the fraction. Notice how 1023*50 = 51150
-    float Beta = (51150 - ADC_E) * R_factor; 
+    // Averaging and conversion to V is implicitly done through the fraction, against the sum at 5 V
+    float Beta = (Full - ADC_E) * R_factor; 
     Beta /= ADC_B;
     Beta -= 1;
 
-    attr::Semiconductor._V1_ = round( (ADC_E - ADC_B)*5000.0/51150.0 ); // A convenient place to temporarily store Vbe
+    *Vbe = round( (ADC_E - ADC_B)*5000.0/Full );
     // Current flow:
     float I_b = 5.0*ADC_B/1023; // To V
-    I_b /= 50; // Average
+    I_b /= n; // Average
     I_b = I_b/(Rb_val + INTERNAL_R_LOW/1000) * 1e3; // Conversion of V to uA for the Base Resistor.
-    attr::Semiconductor.I_B = I_b;
+    *Ib = I_b;
 
     if(Beta < 0){ Beta = 0; } // Sanity Check
     return static_cast<unsigned int>(Beta);
 }
 
 // Measures the Amplification Factor and the Characteristic Voltage Drops.
-unsigned int NPN_Beta_Measure(byte Base, byte Collector, byte Emitter, byte Rb, float Rb_val, byte Re, float Re_val)
-
+unsigned int NPN_Beta_Measure(const Role_Map &BJT, float *Vbe, float *Ib)
 {
+    byte Base = BJT[ROLE_BASE].ID;
+    byte Collector = BJT[ROLE_COLLECTOR].ID;
+    byte Emitter = BJT[ROLE_EMITTER].ID;
+    byte Rb = BJT[ROLE_BASE].Rm;
+    float Rb_val = BJT[ROLE_BASE].Rm_val();
+    byte Re = BJT[ROLE_EMITTER].Rl;
+    float Re_val = BJT[ROLE_EMITTER].Rl_val();
+
     // Setting up the measurement scheme
     pinMode(Base, INPUT);
     pinMode(Collector, OUTPUT);
@@ -328,15 +1075,17 @@ unsigned int NPN_Beta_Measure(byte Base, byte Collector, byte Emitter, byte Rb,
     float R_factor = (Rb_val*1000 + INTERNAL_R_HIGH) / (INTERNAL_R_LOW + Re_val); // Rb_val will be in kOhms
     unsigned int ADC_B = 0;
     unsigned int ADC_E = 0;
+    const byte n = attr::Profile.Pair_Samples;
+    const float Full = 1023.0 * n; // Sum of n readings at 5 V
 
-    for(int i = 0; i<50; i++)
+    for(int i = 0; i<n; i++)
     {
         ADC_B += analogRead(Base);
     }
     delay(1);
     analogRead(Emitter); // Discarding the first measure, after switching ports it may be unreliable
 
-    for(int i = 0; i<50; i++)
+    for(int i = 0; i<n; i++)
     {
         ADC_E += analogRead(Emitter);
     }
@@ -349,289 +1098,378 @@ unsigned int NPN_Beta_Measure(byte Base, byte Collector, byte Emitter, byte Rb,
     pinMode(Rb, INPUT);
     pinMode(Collector, INPUT);
 
-    // Averaging and conversion to V is implicitly done through the fraction. Notice how 1023*50 = 51150
+    // Averaging and conversion to V is implicitly done through the fraction, against the sum at 5 V
     float Beta = ADC_E*R_factor;
-    Beta /= 51150-ADC_B;
+    Beta /= Full-ADC_B;
     Beta -= 1;
 
-    attr::Semiconductor._V1_ = round( (ADC_B - ADC_E)*5000.0/51150.0 ); // A convenient place to temporarily store Vbe
+    *Vbe = round( (ADC_B - ADC_E)*5000.0/Full );
 
     // Current Flow:
 
     float I_b = 5.0*ADC_B/1023.0; // To V
-    I_b /= 50.0; // Average
+    I_b /= n; // Average
 
     I_b = (5 - I_b)/(Rb_val + INTERNAL_R_HIGH/1000) * 1e3; // Conversion of V to uA for the Base Resistor.
 
-    attr::Semiconductor.I_B = I_b;
+    *Ib = I_b;
 
     if(Beta < 0){ Beta = 0; } // Sanity Check
     return static_cast<unsigned int>(Beta);
 }
 
-// NPN can be seen as two diodes with common anode (the base)
-void NPN_Measure(byte bjt_pins[3])
+/*
+ * NPN can be seen as two diodes with common anode (the base), PNP as two with common cathode. The base is
+ * known from the identification, collector and emitter are told apart by measuring the gain both ways
+ * round: the right orientation has the highest Beta, the reverse one gives the Collector - Base drop.
+ */
+void BJT_Measure(Result &DUT, byte BJTType)
 {
-    byte NPNBase = 0;
+    unsigned int Beta[2] = {0,0};   // Best orientation and runner-up
     float VDrop[2] = {0.0,0.0};
-    float Ib[2] = {0.0,0.0};
-    unsigned int Beta[2] = {0,0};
-    const byte ProbeIDs[3] = {P1.ID, P2.ID, P3.ID};
+    bool found = 0;
 
-    // bjt_pins[i] must be 0 or Px.ID, x=1,2,3
-    for(byte i = 0; i<3; i++) 
+    Role_Map BJT(3);
+    do
     {
-        if(bjt_pins[i]) // Any non-zero value will trigger the if statement
+        if(BJT[ROLE_BASE].ID != DUT.Pins[ROLE_BASE]){ continue; }
+
+        float Vbe = 0;
+        float Ib = 0;
+        unsigned int B = (BJTType == PNP_FLAG) ? PNP_Beta_Measure(BJT, &Vbe, &Ib) : NPN_Beta_Measure(BJT, &Vbe, &Ib);
+
+        if(!found || B > Beta[0])
         {
-            NPNBase = bjt_pins[i];
+            Beta[1] = Beta[0]; VDrop[1] = VDrop[0];
+            Beta[0] = B;       VDrop[0] = Vbe;
+
+            DUT.Value[V_IB] = Ib;   // Base Current
+            DUT.Pins[ROLE_COLLECTOR] = BJT[ROLE_COLLECTOR].ID;
+            DUT.Pins[ROLE_EMITTER]   = BJT[ROLE_EMITTER].ID;
+            found = 1;
         }
-    }
+        else if(B > Beta[1])
+        {
+            Beta[1] = B; VDrop[1] = Vbe;
+        }
+    } while(BJT.next());
 
-    attr::Semiconductor.Base = NPNBase;
+    // Normalised to 25 C
+    DUT.Value[V_BETA] = Thermal_25C_Pow(Beta[0], BETA_XTB);
+    DUT.Value[V_VBE] = Thermal_25C_mV(VDrop[0], DIODE_TC_MV);   // Base - Emitter Voltage Drop
+    DUT.Value[V_VCB] = Thermal_25C_mV(VDrop[1], DIODE_TC_MV);   // Collector - Base Voltage Drop
 
-    // Measuring Voltage drops and beta, for all 3 possibilities
-    if(NPNBase == P1.ID)
+    if(attr::Output_Mode == TEXT_MODE) // Remarks would corrupt the binary frames
     {
-        Beta[1] = NPN_Beta_Measure(NPNBase, P2.ID, P3.ID, P1.Rm, P1.Rm_val, P3.Rl, P3.Rl_val);
-        VDrop[1] = attr::Semiconductor._V1_;    // Recovering the value of Vbe
-        Ib[1] = attr::Semiconductor.I_B;        // Recovering the value of Ib
+        if(Beta[0] == Beta[1]){ Link.println(F("Symmetrical BJT")); }
+        else if(Beta[0] < 2*Beta[1]){ Link.println(F("Possibly Symmetrical BJT")); }
+    }
+}
 
-        Beta[2] = NPN_Beta_Measure(NPNBase, P3.ID, P2.ID, P1.Rm, P1.Rm_val, P2.Rl, P2.Rl_val);
-        VDrop[2] = attr::Semiconductor._V1_;    // Recovering the value of Vbe
-        Ib[2] = attr::Semiconductor.I_B;        // Recovering the value of Ib
+/*
+ * Threshold capture. The drain is watched by its pin change interrupt (the probes are on port C, PCINT1), and the
+ * handler starts the conversion of the gate at once: the ADC holds its sample 1.5 ADC clocks later, so the gate is
+ * read a fixed ~15 us after the drain switches whatever the main loop is doing. The conversion channel is set up
+ * before the gate is released, the handler only sets ADSC.
+ */
+static volatile byte *Mos_Drain_Port;       // Input register of the drain
+static volatile byte Mos_Drain_Mask;        // Drain bit in it
+static volatile byte Mos_Drain_On;          // Drain bit while the FET conducts
+static volatile bool Mos_Captured;
+static volatile unsigned long Mos_Edge_us;
 
-        Assign_BJT(VDrop, Beta, Ib, P2.ID, P3.ID);
-    }
-    else if(NPNBase == P2.ID)
-    {
-        Beta[1] = NPN_Beta_Measure(NPNBase, P1.ID, P3.ID, P2.Rm, P2.Rm_val, P3.Rl, P3.Rl_val);
-        VDrop[1] = attr::Semiconductor._V1_; // Recovering the value of Vbe
-        Ib[1] = attr::Semiconductor.I_B;        // Recovering the value of Ib
+ISR(PCINT1_vect)
+{
+    if((*Mos_Drain_Port & Mos_Drain_Mask) != Mos_Drain_On){ return; } // Not the conduction edge
+    ADCSRA |= (1 << ADSC);
+    Mos_Edge_us = micros();
+    Mos_Captured = 1;
+    PCMSK1 = 0; // One capture per arming
+}
 
-        Beta[2] = NPN_Beta_Measure(NPNBase, P3.ID, P1.ID, P2.Rm, P2.Rm_val, P1.Rl, P1.Rl_val);
-        VDrop[2] = attr::Semiconductor._V1_; // Recovering the value of Vbe
-        Ib[2] = attr::Semiconductor.I_B;        // Recovering the value of Ib
+/*
+ * Releases the gate towards the on state through "Ramp" and waits for the drain to switch, "deadline_us" at most.
+ * Returns the ADC reading of the gate at the edge (-1 on timeout) and the time the edge took in *time (us).
+ */
+static int mos_capture(byte Drain, byte Gate, byte Ramp, bool on_level, unsigned long deadline_us, unsigned long *time)
+{
+    Mos_Drain_Port = portInputRegister(digitalPinToPort(Drain));
+    Mos_Drain_Mask = digitalPinToBitMask(Drain);
+    Mos_Drain_On = on_level ? Mos_Drain_Mask : 0;
+    Mos_Captured = 0;
+    *time = 0;
 
-        Assign_BJT(VDrop, Beta, Ib, P1.ID, P3.ID);
-    }
-    else if(NPNBase == P3.ID)
-    {
-        Beta[1] = NPN_Beta_Measure(NPNBase, P1.ID, P2.ID, P3.Rm, P3.Rm_val, P2.Rl, P2.Rl_val);
-        VDrop[1] = attr::Semiconductor._V1_; // Recovering the value of Vbe
-        Ib[1] = attr::Semiconductor.I_B;        // Recovering the value of Ib
+    ADMUX = (1 << REFS0) | ((Gate - 14) & 0x07); // Gate channel, AVcc reference (as analogRead)
 
-        Beta[2] = NPN_Beta_Measure(NPNBase, P2.ID, P1.ID, P3.Rm, P3.Rm_val, P1.Rl, P1.Rl_val);
-        VDrop[2] = attr::Semiconductor._V1_; // Recovering the value of Vbe
-        Ib[2] = attr::Semiconductor.I_B;        // Recovering the value of Ib
+    if((*Mos_Drain_Port & Mos_Drain_Mask) == Mos_Drain_On){ return analogRead(Gate); } // Already conducting (depletion)
 
-        Assign_BJT(VDrop, Beta, Ib, P1.ID, P2.ID);
-    }
+    PCIFR = (1 << digitalPinToPCICRbit(Drain)); // Clearing a stale request
+    *digitalPinToPCMSK(Drain) = (1 << digitalPinToPCMSKbit(Drain));
+    PCICR |= (1 << digitalPinToPCICRbit(Drain));
 
-    return;
+    unsigned long start = micros();
+    digitalWrite(Ramp, !on_level); // NMOS: the drain goes LOW as the gate rises, the other way round for PMOS
 
+    while(!Mos_Captured && micros() - start < deadline_us){}
+
+    *digitalPinToPCMSK(Drain) = 0;
+    PCICR &= ~(1 << digitalPinToPCICRbit(Drain));
+    if(!Mos_Captured){ return -1; }
+
+    *time = Mos_Edge_us - start;
+    while(ADCSRA & (1 << ADSC)){} // Conversion under way, 13 ADC clocks
+    return ADC;
 }
 
-// PNP can be seen as two diodes with common cathode (the base)
-void PNP_Measure(byte bjt_pins[3]) 
+/*
+ * Gate charge. Ciss from the time the gate takes to reach the bandgap through Rh (Rm for the gates too large for
+ * it), drain and source at GND. Qg by integrating the gate current through Rh while the gate is driven to
+ * MOS_QG_MV against a drain loaded through Rl, so the charge of the Miller plateau is included.
+ */
+static void mos_gate_charge(Result &DUT, const Probe &D, const Probe &G, const Probe &S, bool Is_PMOS)
 {
-    byte PNPBase = 0;
-    float VDrop[2] = {0.0,0.0};
-    float Ib[2] = {0.0,0.0};
-    unsigned int Beta[2] = {0,0};
+    const float factor = 1 / log(5 / (5 - BANDGAP_V)); // 1/ln(V0/(V0 - Vref)), with V_ref = 1.1V and V0 = 5V
 
-    const byte ProbeIDs[3] = {P1.ID, P2.ID, P3.ID};
-    
-    // Identifying the PNPBase, we know the two anodes. This simply checks which probe is not an anode.
-    for(byte i = 0; i<3; i++) 
-    {
-        if(bjt_pins[0] != ProbeIDs[i] && bjt_pins[1] != ProbeIDs[i] && bjt_pins[2] != ProbeIDs[i])
-        {
-            PNPBase = ProbeIDs[i];
-        }
-    }
+    pinMode(D.ID, OUTPUT);
+    pinMode(S.ID, OUTPUT);
+    digitalWrite(D.ID, LOW);
+    digitalWrite(S.ID, LOW);
 
-    attr::Semiconductor.Base = PNPBase;
-
-    // Measuring Voltage drops and beta, for all 3 possibilities
-    if(PNPBase == P1.ID)
+    unsigned long time = 0;
+    byte Shunt = SHUNT_H;
+    byte Tflag = ChargeTMeasure(G, Shunt, 1, 50, &time);
+    if(Tflag == 10) // Timeout, a large gate
     {
-        Beta[1] = PNP_Beta_Measure(PNPBase, P2.ID, P3.ID, P1.Rm, P1.Rm_val, P3.Rl, P3.Rl_val);
-        VDrop[1] = attr::Semiconductor._V1_; // Recovering the value of Vbe
-        Ib[1] = attr::Semiconductor.I_B;        // Recovering the value of Ib
-
-        Beta[2] = PNP_Beta_Measure(PNPBase, P3.ID, P2.ID, P1.Rm, P1.Rm_val, P2.Rl, P2.Rl_val);
-        VDrop[2] = attr::Semiconductor._V1_; // Recovering the value of Vbe
-        Ib[2] = attr::Semiconductor.I_B;        // Recovering the value of Ib
-
-        Assign_BJT(VDrop, Beta, Ib, P2.ID, P3.ID);
+        Shunt = SHUNT_M;
+        Tflag = ChargeTMeasure(G, Shunt, 1, 50, &time);
     }
-    else if(PNPBase == P2.ID)
-    {
-        Beta[1] = PNP_Beta_Measure(PNPBase, P1.ID, P3.ID, P2.Rm, P2.Rm_val, P3.Rl, P3.Rl_val);
-        VDrop[1] = attr::Semiconductor._V1_; // Recovering the value of Vbe
-        Ib[1] = attr::Semiconductor.I_B;        // Recovering the value of Ib
+    float R = 0;
+    Shunt_Pin(G, Shunt, &R);
+    DUT.Value[V_CISS] = (Tflag == 10) ? 0 : factor * time / (R + INTERNAL_R_HIGH) * 1000; // ns / Ohms = nF, to pF
+
+    // Source to its rail, drain through Rl to the other, gate discharged to the source
+    digitalWrite(S.ID, Is_PMOS ? HIGH : LOW);
+    pinMode(D.ID, INPUT);
+    pinMode(D.Rl, OUTPUT);
+    digitalWrite(D.Rl, Is_PMOS ? LOW : HIGH);
+
+    byte Ramp = Shunt_Pin(G, SHUNT_H, &R);
+    pinMode(G.Rl, OUTPUT);
+    pinMode(Ramp, OUTPUT);
+    digitalWrite(G.Rl, Is_PMOS);
+    digitalWrite(Ramp, Is_PMOS);
+    delay(1);
+    pinMode(G.Rl, INPUT);
 
-        Beta[2] = PNP_Beta_Measure(PNPBase, P3.ID, P1.ID, P2.Rm, P2.Rm_val, P1.Rl, P1.Rl_val);
-        VDrop[2] = attr::Semiconductor._V1_; // Recovering the value of Vbe
-        Ib[2] = attr::Semiconductor.I_B;        // Recovering the value of Ib
+    float Q = 0;            // nC
+    float I_last = 5000 / (R + INTERNAL_R_HIGH); // mA, at the start the whole 5V is across the shunt
+    unsigned long start = micros();
+    unsigned long last = start;
+    bool reached = 0;
 
-        Assign_BJT(VDrop, Beta, Ib, P1.ID, P3.ID);
-    }
-    else if(PNPBase == P3.ID)
+    digitalWrite(Ramp, !Is_PMOS);
+    while(micros() - start < MOS_TIMEOUT_MS * 1000UL)
     {
-        Beta[1] = PNP_Beta_Measure(PNPBase, P1.ID, P2.ID, P3.Rm, P3.Rm_val, P2.Rl, P2.Rl_val);
-        VDrop[1] = attr::Semiconductor._V1_; // Recovering the value of Vbe
-        Ib[1] = attr::Semiconductor.I_B;        // Recovering the value of Ib
-
-        Beta[2] = PNP_Beta_Measure(PNPBase, P2.ID, P1.ID, P3.Rm, P3.Rm_val, P1.Rl, P1.Rl_val);
-        VDrop[2] = attr::Semiconductor._V1_; // Recovering the value of Vbe
-        Ib[2] = attr::Semiconductor.I_B;        // Recovering the value of Ib
-
-        Assign_BJT(VDrop, Beta, Ib, P1.ID, P2.ID);
+        float V = analogRead(G.ID) * 5000.0 / 1023;
+        unsigned long now = micros();
+        float Vgs = Is_PMOS ? 5000 - V : V;                 // Drive magnitude
+        float I = (5000 - Vgs) / (R + INTERNAL_R_HIGH);     // mA
+
+        Q += (I + I_last) / 2 * (now - last);               // mA * us = nC
+        I_last = I;
+        last = now;
+        if(Vgs >= MOS_QG_MV){ reached = 1; break; }
     }
+    DUT.Value[V_QG] = reached ? Q : 0;
+
+    digitalWrite(Ramp, LOW);
+    digitalWrite(D.Rl, LOW);
+    digitalWrite(S.ID, LOW);
+    pinMode(Ramp, INPUT);
+    pinMode(D.Rl, INPUT);
+    pinMode(S.ID, INPUT);
+}
 
-    return;
+/*
+ * On resistance with the gate driven straight from its pin (full 5V), the source at its rail and the drain through
+ * Rl to the other. Ratiometric: Rds = (Vd - Vs) / I, with I from the drop across Rl, so the pin resistances cancel.
+ */
+static void mos_rds_on(Result &DUT, const Probe &D, const Probe &G, const Probe &S, bool Is_PMOS)
+{
+    pinMode(G.ID, OUTPUT);
+    pinMode(S.ID, OUTPUT);
+    pinMode(D.ID, INPUT);
+    pinMode(D.Rl, OUTPUT);
+    digitalWrite(G.ID, Is_PMOS ? LOW : HIGH);
+    digitalWrite(S.ID, Is_PMOS ? HIGH : LOW);
+    digitalWrite(D.Rl, Is_PMOS ? LOW : HIGH);
+    delay(DIODE_SETTLE_MS);
+
+    float Vd = oversampled_mV(D.ID);
+    float Vs = oversampled_mV(S.ID);
+    float I = (Is_PMOS ? Vd : 5000 - Vd) / (D.Rl_val() + (Is_PMOS ? INTERNAL_R_LOW : INTERNAL_R_HIGH)); // mA
+
+    DUT.Value[V_RDS_ON] = (I > 0) ? Thermal_25C_Pow(fabs(Vd - Vs) / I, RDS_ON_EXP) : 0; // mV / mA = Ohms, at 25 C
+
+    digitalWrite(G.ID, LOW);
+    digitalWrite(S.ID, LOW);
+    digitalWrite(D.Rl, LOW);
+    pinMode(G.ID, INPUT);
+    pinMode(S.ID, INPUT);
+    pinMode(D.Rl, INPUT);
 }
 
-void MOS_Measure(byte MOSType)
+/*
+ * Measures the threshold Vgs of a MOSFET with its pins by role. The gate is discharged through Rl and ramped
+ * through a shunt (Rh at first) until the drain switches, Mos_Repeats times (see the profile). The first ramp gives the gate time
+ * constant, from which the discharge time and the deadlines of the following ramps are set, and through which the
+ * fastest shunt still giving MOS_MIN_RAMP_US to the threshold is picked. Rds(on), Ciss and Qg follow in the same
+ * insertion. Returns 1 if the drain never switched.
+ */
+bool MOS_Measure(Result &DUT, byte MOSType)
 {
     // Initialization and variable selection
-    byte Drain  = attr::Semiconductor.Collector;
-    byte Gate   = attr::Semiconductor.Base;
-    byte Source = attr::Semiconductor.Emitter;
+    byte Drain  = DUT.Pins[ROLE_DRAIN];
+    byte Gate   = DUT.Pins[ROLE_GATE];
+    byte Source = DUT.Pins[ROLE_SOURCE];
 
-    byte Drain_Rl; byte Source_Rl; byte Gate_Rh; byte Gate_Rl;
-    float Rl_val = 0;
+    const Probe *DrainP  = Probe_By_ID(Drain);
+    const Probe *GateP   = Probe_By_ID(Gate);
+    const Probe *SourceP = Probe_By_ID(Source);
+    if(!DrainP || !GateP || !SourceP){ return 1; }
 
-    if      (Drain == P1.ID){ Drain_Rl = P1.Rl; Rl_val = P1.Rl_val;}
-    else if (Drain == P2.ID){ Drain_Rl = P2.Rl; Rl_val = P2.Rl_val;}
-    else if (Drain == P3.ID){ Drain_Rl = P3.Rl; Rl_val = P3.Rl_val;}
-    else{return;}
-
-    if      (Gate == P1.ID){ Gate_Rl = P1.Rl; Gate_Rh = P1.Rh; }
-    else if (Gate == P2.ID){ Gate_Rl = P2.Rl; Gate_Rh = P2.Rh; }
-    else if (Gate == P3.ID){ Gate_Rl = P3.Rl; Gate_Rh = P3.Rh; }
-    else{return;}
-
-    if      (Source == P1.ID){ Source_Rl = P1.Rl; }
-    else if (Source == P2.ID){ Source_Rl = P2.Rl; }
-    else if (Source == P3.ID){ Source_Rl = P3.Rl; }
-    else{return;}
+    byte Drain_Rl = DrainP->Rl; byte Source_Rl = SourceP->Rl; byte Gate_Rl = GateP->Rl;
 
     pinMode(Gate, INPUT);
     pinMode(Drain, INPUT);
     pinMode(Drain_Rl, INPUT);
     pinMode(Source_Rl, INPUT);
     pinMode(Source, INPUT);
-    bool Gate_Pullup = 1;
 
     bool Is_PMOS = MOSType == PMOS_ENH_FLAG;
-    float Vgs = 0;
+    bool Gate_Off = Is_PMOS; // Gate level keeping the FET off
 
-    // Measurement of Threshold Vgs
-    if(Is_PMOS) // PMOS
-    {
-        pinMode(Drain_Rl, OUTPUT);
-        pinMode(Source, OUTPUT);
+    // Source to its rail and drain through Rl to the other: the drain goes to the source rail as the FET conducts
+    pinMode(Drain_Rl, OUTPUT);
+    pinMode(Source, OUTPUT);
+    digitalWrite(Source, Is_PMOS ? HIGH : LOW);
+    digitalWrite(Drain_Rl, Is_PMOS ? LOW : HIGH);
 
-        digitalWrite(Source, HIGH);
-        digitalWrite(Drain_Rl, LOW);
-    }
-    else // NMOS
-    {
-        pinMode(Drain_Rl, OUTPUT);
-        pinMode(Source, OUTPUT);
-        
-        digitalWrite(Source, LOW);
-        digitalWrite(Drain_Rl, HIGH);
-        Gate_Pullup = 0;
-    }
+    byte Ramp_Size = SHUNT_H;
+    float R_ramp = 0;
+    byte Ramp = Shunt_Pin(*GateP, Ramp_Size, &R_ramp);
 
-    // We repeat the measurement 10 times
-    for(byte i = 0; i<10; i++)
+    unsigned long deadline_us = Budget_ms(MOS_TIMEOUT_MS) * 1000UL;
+    unsigned long discharge_us = MOS_TIMEOUT_MS * 1000UL; // Until the gate capacitance is known
+    float Vgs = 0;
+    byte captures = 0;
+
+    for(byte i = 0; i < attr::Profile.Mos_Repeats; i++)
     {
-        // We charge/discharge the gate
-        pinMode(Gate_Rl, OUTPUT);
-        pinMode(Gate_Rh, OUTPUT);
+        // Another ramp only if the discharge and the capture still fit in the time budget
+        unsigned long repeat_ms = (discharge_us + deadline_us) / 1000 + 1;
+        if(i && Budget_ms(repeat_ms) < repeat_ms){ Budget_Partial(PARTIAL_SAMPLES); break; }
 
-        digitalWrite(Gate_Rl, Gate_Pullup);
-        digitalWrite(Gate_Rh, Gate_Pullup);
-        delay(10); // Wait 10ms to charge/discharge gate
+        // Discharging the gate through Rl, the ramp shunt held at the same level
+        pinMode(Gate_Rl, OUTPUT);
+        pinMode(Ramp, OUTPUT);
+        digitalWrite(Gate_Rl, Gate_Off);
+        digitalWrite(Ramp, Gate_Off);
+        if(discharge_us >= 16000){ delay(discharge_us / 1000); } else { delayMicroseconds(discharge_us); }
 
         digitalWrite(Gate_Rl, LOW);
         pinMode(Gate_Rl, INPUT);
-        delay(10);  // Additional time to compensate the setting change on Gate_Rl
-
-        digitalWrite(Gate_Rh, !Gate_Pullup);
 
-        if (Is_PMOS)          // p-channel
-        {
-        // FET conducts when the voltage at drain reaches high level
-        while (!digitalRead(Drain)){};
-        }
-        else                  // n-channel
+        unsigned long time;
+        int ADC_Reading = mos_capture(Drain, Gate, Ramp, Is_PMOS ? HIGH : LOW, deadline_us, &time);
+        if(ADC_Reading < 0)
         {
-        // FET conducts when the voltage at drain reaches low level
-        while (digitalRead(Drain)){};             
+            if(!captures) // Not switching within MOS_TIMEOUT_MS, the part is not going to
+            {
+                Budget_Timeout(deadline_us / 1000, MOS_TIMEOUT_MS);
+                break;
+            }
+            continue;
         }
 
-        int ADC_Reading = analogRead(Gate);
+        float V = ADC_Reading * 5000.0 / 1023; // To mV
+        Vgs += Is_PMOS ? V - 5000 : V;
+        captures ++;
 
-        if(Is_PMOS)
-        {
-            Vgs -= (1023 - ADC_Reading);
-        }
-        else
+        if(i || !time){ continue; }
+
+        /*
+         * Gate time constant from the first ramp: the gate reaches |Vgs| after tau * ln(5 V / (5 V - |Vgs|)).
+         * It scales with the shunt, so the ramp can be sped up where the threshold stays MOS_MIN_RAMP_US away.
+         */
+        float Vth = Is_PMOS ? 5000 - V : V;
+        float ln = (Vth > 0 && Vth < 4950) ? log(5000 / (5000 - Vth)) : 1;
+        float C = time / (ln * (R_ramp + INTERNAL_R_HIGH)); // uF, from us and Ohms
+
+        for(byte s = SHUNT_L; s < SHUNT_H; s++)
         {
-            Vgs += ADC_Reading;
+            float R = 0;
+            Shunt_Pin(*GateP, s, &R);
+            if(time * (R + INTERNAL_R_HIGH) / (R_ramp + INTERNAL_R_HIGH) >= MOS_MIN_RAMP_US)
+            {
+                pinMode(Ramp, INPUT);
+                Ramp_Size = s;
+                break;
+            }
         }
+        float R_new = 0;
+        Ramp = Shunt_Pin(*GateP, Ramp_Size, &R_new);
+
+        unsigned long expected = time * (R_new + INTERNAL_R_HIGH) / (R_ramp + INTERNAL_R_HIGH);
+        deadline_us = min(MOS_DEADLINE_FACTOR * expected + 1000UL, MOS_TIMEOUT_MS * 1000UL);
+        discharge_us = 5 * C * (GateP->Rl_val() + INTERNAL_R_LOW) + 100; // 5 time constants through Rl
+        R_ramp = R_new;
     }
-    // Reseting used pins
 
-    digitalWrite(Gate_Rh, LOW);
+    // Reseting used pins
+    digitalWrite(Ramp, LOW);
     digitalWrite(Source, LOW);
     digitalWrite(Drain_Rl, LOW);
 
-    //pinMode(Gate_Rl, INPUT); // Already set
-    pinMode(Gate_Rh, INPUT);
-    //pinMode(Gate, INPUT); // Already set
+    pinMode(Ramp, INPUT);
+    pinMode(Gate_Rl, INPUT);
     pinMode(Drain, INPUT);
     pinMode(Drain_Rl, INPUT);
     pinMode(Source_Rl, INPUT);
     pinMode(Source, INPUT);
 
-    Vgs *= 5000/1023; // To mV
-    Vgs /= 10; // Average
-    
-    attr::Semiconductor._V1_ = round(Vgs/10)*10; // Rounding to 10 mV
-    return;
+    if(!captures){ return 1; }
+
+    Vgs /= captures; // Average
+    DUT.Value[V_VGS_TH] = round(Thermal_25C_mV(Vgs, VGS_TH_TC_MV)/10)*10; // At 25 C, rounding to 10 mV
+
+    if(Budget_ms(MOS_OPTIONAL_MS) < MOS_OPTIONAL_MS) // Rds(on), Ciss and Qg are extras, the threshold is the result
+    {
+        Budget_Partial(PARTIAL_DROPPED);
+        return 0;
+    }
+    mos_rds_on(DUT, *DrainP, *GateP, *SourceP, Is_PMOS);
+    mos_gate_charge(DUT, *DrainP, *GateP, *SourceP, Is_PMOS);
+    return 0;
 }
 
-bool Get_DS(byte Gate2GND)
+bool Get_DS(Result &DUT, const Probe &Gate)
 {
+    byte Gate2GND = Gate.Rl;
     pinMode(Gate2GND, OUTPUT);
     digitalWrite(Gate2GND, LOW);
 
-    // The suspects
-    byte ID_A = 0; byte R_A = 0; 
-    byte ID_B = 0; byte R_B = 0;
-
-    if(Gate2GND = P1.Rl)
-    { 
-        ID_A = P2.ID; R_A = P2.Rl;
-        ID_B = P3.ID; R_B = P3.Rl;
-    }
-    else if(Gate2GND = P2.Rl)
+    // The suspects, the two probes other than the gate
+    const Probe *Suspect[2] = {0, 0};
+    byte n = 0;
+    for(byte p = 0; p < PROBE_COUNT && n < 2; p++)
     {
-        ID_A = P1.ID; R_A = P1.Rl;
-        ID_B = P3.ID; R_B = P3.Rl;
+        if(Probes[p] != &Gate){ Suspect[n++] = Probes[p]; }
     }
-    else if(Gate2GND = P3.Rl)
-    {
-        ID_A = P2.ID; R_A = P2.Rl;
-        ID_B = P1.ID; R_B = P1.Rl;
-    }
-    else{return 0;} // Error
+    if(n < 2){ pinMode(Gate2GND, INPUT); return 0; } // Error
+
+    byte ID_A = Suspect[0]->ID; byte R_A = Suspect[0]->Rl;
+    byte ID_B = Suspect[1]->ID; byte R_B = Suspect[1]->Rl;
 
     // The Proof Variables
     unsigned int ADC_A = 0;
@@ -646,7 +1484,7 @@ bool Get_DS(byte Gate2GND)
     digitalWrite(ID_B, HIGH);
     digitalWrite(R_A, LOW);
 
-    for(byte i=0; i<50; i++){ ADC_B += analogRead(ID_B);}
+    for(byte i=0; i<attr::Profile.Pair_Samples; i++){ ADC_B += analogRead(ID_B);}
 
     digitalWrite(ID_B, LOW);
 
@@ -658,7 +1496,7 @@ bool Get_DS(byte Gate2GND)
     digitalWrite(ID_A, HIGH);
     digitalWrite(R_B, LOW);
 
-    for(byte i=0; i<50; i++){ ADC_A += analogRead(ID_A);}
+    for(byte i=0; i<attr::Profile.Pair_Samples; i++){ ADC_A += analogRead(ID_A);}
 
     digitalWrite(ID_A, LOW);
     pinMode(ID_A, INPUT);
@@ -674,15 +1512,16 @@ bool Get_DS(byte Gate2GND)
 
     if(ADC_A > ADC_B)
     {
-        attr::Semiconductor.Collector = ID_B;
-        attr::Semiconductor.Emitter = ID_A;
+        DUT.Pins[ROLE_DRAIN]  = ID_B;
+        DUT.Pins[ROLE_SOURCE] = ID_A;
     }
     else if (ADC_B > ADC_A)
     {
-        attr::Semiconductor.Collector = ID_A;
-        attr::Semiconductor.Emitter = ID_B;
+        DUT.Pins[ROLE_DRAIN]  = ID_A;
+        DUT.Pins[ROLE_SOURCE] = ID_B;
     }
     else{ return 0; } // Failure, proof is inconclusive
     return 1; // Success, bad guys apprehended
 }
+
 #undef MEASURE_CPP
\ No newline at end of file
@@ -0,0 +1,146 @@
+#define METER_CPP
+
+#include "common.h"
+#include "config.h"
+#include "functions.h"
+
+/*
+ * Live meter, for tuning trimmers or picking parts on the bench without a full identification per reading.
+ *
+ * One identification fixes the kind of part (resistor, capacitor or inductor) and the probe pair, then only its
+ * value routine is repeated:
+ *
+ *  Resistor    Resistance_Auto, the range chosen by the running value, averaging what fits in METER_WINDOW_MS
+ *  Capacitor   CapacitorTMeasure after a discharge, so one reading takes a few time constants
+ *  Inductor    InductorTMeasure, against the R_parasit of the identification
+ *
+ * The readings go through an exponential moving average (METER_EMA_ALPHA), restarted on a step larger than
+ * METER_STEP so a turned trimmer is followed at once. An update is only reported when the average moves by more
+ * than METER_DEADBAND, so a steady part keeps the link quiet. The readings keep the die temperature of the
+ * identification: the loop never resamples it.
+ */
+
+// Factor of a value prefix (see Result::Power), to compare readings taken with different ones.
+static float prefix_scale(char power)
+{
+    switch (power)
+    {
+        case 'k': return 1e3;
+        case 'u': return 1e-6;
+        case 'n': return 1e-9;
+        case 'p': return 1e-12;
+    }
+    return 1;
+}
+
+// Empties a capacitor through both Rl. Returns 1 on timeout.
+static bool meter_discharge(const Probe &A, const Probe &B)
+{
+    pinMode(A.Rl, OUTPUT);
+    pinMode(B.Rl, OUTPUT);
+    digitalWrite(A.Rl, LOW);
+    digitalWrite(B.Rl, LOW);
+
+    unsigned long start = millis();
+    bool timeout = 0;
+    while(analogRead(A.ID) > 1 || analogRead(B.ID) > 1) // Polled, not in 100 ms steps as wait_discharge does
+    {
+        if(millis() - start > DISCHARGE_TIMEOUT_MS){ timeout = 1; break; }
+    }
+
+    pinMode(A.Rl, INPUT);
+    pinMode(B.Rl, INPUT);
+    return timeout;
+}
+
+/*
+ * One reading of the part into DUT, "previous" being the running value (Ohms for a resistor). Returns 1 if it failed,
+ * for a resistor when the divider sat at a rail (open probes, no value to average).
+ */
+static bool reading(Result &DUT, const Probe &A, const Probe &B, float previous, byte *R_Mode)
+{
+    unsigned long time = 0;
+
+    if(DUT.Flag == RESISTOR_FLAG)
+    {
+        Budget_Start(METER_WINDOW_MS); // Resistance_Measure averages the samples that fit in the window
+        Resistance_Auto(DUT, A, B, previous);
+        Budget_End();
+
+        float R = DUT.Value[V_RESISTANCE];
+        return !(R >= 0) || isinf(R) || !DUT.Uncertainty; // No uncertainty: out of range of every shunt
+    }
+
+    if(DUT.Flag == CAPACITOR_FLAG)
+    {
+        if(meter_discharge(A, B)){ return 1; }
+
+        byte Tflag = CapacitorTMeasure(A, B, *R_Mode, &time);
+        if(Tflag == 10 && *R_Mode) // Timeout: too big for Rm, through Rl from now on
+        {
+            *R_Mode = 0;
+            if(meter_discharge(A, B)){ return 1; }
+            Tflag = CapacitorTMeasure(A, B, *R_Mode, &time);
+        }
+        if(Tflag){ return 1; }
+
+        DUT.Value[V_CAPACITANCE] = Capacitor_Value(DUT, A, B, *R_Mode, time);
+        return 0;
+    }
+
+    // Inductor
+    float R_dc = DUT.Value[V_R_PARASIT];
+    bool High_Current = (R_dc < RL_HIGH_CURRENT_MAX_R);
+    if(InductorTMeasure(A, B, High_Current, &time)){ return 1; }
+
+    DUT.Value[V_INDUCTANCE] = Inductance_Measure(High_Current ? 0 : A.Rl_val(), R_dc, time);
+    return 0;
+}
+
+/*
+ * Runs the meter on the part of an identification result (RESISTOR_FLAG, CAPACITOR_FLAG or INDUCTOR_FLAG), reporting
+ * every update with the averaged value, until a character arrives on the link (it is left there for Command_Poll).
+ * Returns 0 once stopped, 1 if the part cannot be metered or METER_MAX_MISSES readings in a row failed (removed).
+ */
+byte Meter_Run(byte request, Result &DUT, void (*report)(byte request, const Result &DUT))
+{
+    if(DUT.Flag != RESISTOR_FLAG && DUT.Flag != CAPACITOR_FLAG && DUT.Flag != INDUCTOR_FLAG){ return 1; }
+
+    const Probe *A = Probe_By_ID(DUT.Pins[ROLE_A]);
+    const Probe *B = Probe_By_ID(DUT.Pins[ROLE_B]);
+    if(!A || !B){ return 1; }
+
+    const float spread = sqrt(METER_EMA_ALPHA / (2 - METER_EMA_ALPHA)); // Of the average, against a single reading
+    float average = DUT.Value[0] * prefix_scale(DUT.Power);
+    float sent = NAN; // The first average is always reported
+    byte R_Mode = 1;
+    byte misses = 0;
+
+    while(!Link.available())
+    {
+        unsigned long start = millis();
+
+        if(reading(DUT, *A, *B, average, &R_Mode))
+        {
+            if(++misses >= METER_MAX_MISSES){ return 1; }
+            continue;
+        }
+        misses = 0;
+
+        float scale = prefix_scale(DUT.Power);
+        float x = DUT.Value[0] * scale;
+        if(fabs(x - average) > METER_STEP * fabs(average)){ average = x; } // A new value, not noise
+        else { average += METER_EMA_ALPHA * (x - average); }
+
+        if(fabs(average - sent) <= METER_DEADBAND * fabs(sent)){ continue; }
+
+        sent = average;
+        DUT.Value[0] = average / scale;
+        DUT.Uncertainty *= spread;
+        DUT.Elapsed = millis() - start;
+        report(request, DUT);
+    }
+    return 0;
+}
+
+#undef METER_CPP
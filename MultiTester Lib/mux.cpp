@@ -0,0 +1,125 @@
+#define MUX_CPP
+
+#include "common.h"
+#include "config.h"
+#include "functions.h"
+
+/*
+ * Socket multiplexer, to sweep a tray of parts with a single tester.
+ *
+ * Each probe goes through its own analog multiplexer (CD4051 style, or a CD4067 for up to 16 sockets) with the
+ * select and inhibit lines shared, so selecting a socket routes the three probes to its three pins.
+ *
+ * Every socket pin also has a bleed resistor to GND (MUX_BLEED_R, see config.h) through an analog switch, so a
+ * part keeps discharging on its own once the probes have moved on. The bleed must not load the part while it is
+ * measured, so the switches of a socket are only closed while the socket is deselected:
+ *
+ *                  select lines ---+--- probe muxes (S0..S2)
+ *                                  +--- 74HC138 A0..A2, G1 HIGH, G2A/G2B on the inhibit line
+ *
+ *      socket n pin ---[ 74HC4066 switch ]---[ MUX_BLEED_R ]--- GND      (control: decoder output Yn)
+ *
+ * The decoder drives the output of the selected socket LOW (its three switches open) and all the others HIGH
+ * (bleeding). While the probe muxes are inhibited the decoder is disabled too, every output HIGH, so all the
+ * sockets bleed. A 74HC154 does the same for 16 sockets. A two terminal part sees two bleed resistors in series.
+ *
+ * The slow part of an identification is waiting for the part to discharge. The sequencer does not wait: once a
+ * socket is measured it is deselected, bleeding, and the sequencer moves on, noting when the part will be
+ * discharged (5 time constants through the bleed resistors for capacitors, at once for anything else). Sockets
+ * are visited round robin, skipping the ones still discharging while others are ready, so repeated sweeps measure
+ * one socket while the previous ones settle.
+ *
+ * The hardware is reached through the Mux hooks, which a host build may point at a simulated socket bank (see
+ * Host/mux_sim.cpp).
+ */
+
+static const byte Mux_Select_Pins[MUX_SELECT_BITS] = MUX_SELECT_PINS;
+
+static void mux_select(byte socket)
+{
+    pinMode(MUX_INHIBIT_PIN, OUTPUT); // Whichever call comes first
+    if(!socket)
+    {
+        digitalWrite(MUX_INHIBIT_PIN, HIGH); // All probe switches open, every socket bleeding
+        return;
+    }
+
+    for(byte b = 0; b < MUX_SELECT_BITS; b++)
+    {
+        pinMode(Mux_Select_Pins[b], OUTPUT);
+        digitalWrite(Mux_Select_Pins[b], ((socket - 1) >> b) & 1);
+    }
+    digitalWrite(MUX_INHIBIT_PIN, LOW);
+    delay(MUX_SWITCH_MS); // Switch on time and charge injection
+}
+
+static byte mux_identify(Result &DUT)
+{
+    return identify(DUT, 0);
+}
+
+Mux_Hooks Mux = {mux_select, mux_identify, millis};
+
+// Time the part needs to discharge through the bleed resistors of its socket (ms).
+static unsigned long discharge_time(const Result &DUT)
+{
+    if(DUT.Flag != CAPACITOR_FLAG){ return 0; }
+
+    return 5 * Capacitance_F(DUT) * (2.0 * MUX_BLEED_R) * 1000; // One bleed resistor on each pin
+}
+
+/*
+ * Measures "rounds" times the parts on sockets 1 to "sockets", reporting each result with its socket number
+ * as soon as it is ready. Returns the number of results reported.
+ */
+unsigned int Mux_Sweep(byte request, byte sockets, byte rounds, void (*report)(byte request, const Result &DUT))
+{
+    unsigned long ready[MUX_SOCKETS];   // When each socket is discharged
+    byte pending[MUX_SOCKETS];          // Measurements left on each socket
+    unsigned int done = 0;
+
+    if(sockets > MUX_SOCKETS){ sockets = MUX_SOCKETS; } // Sanity check
+    byte last = sockets - 1; // The first turn goes to socket 1
+    for(byte s = 0; s < sockets; s++)
+    {
+        ready[s] = 0;
+        pending[s] = rounds;
+    }
+
+    while(1)
+    {
+        // Next socket in turn that is ready, otherwise the one that will be ready first
+        unsigned long now = Mux.now();
+        byte next = MUX_SOCKETS;
+
+        for(byte i = 1; i <= sockets; i++)
+        {
+            byte s = (last + i) % sockets;
+            if(!pending[s]){ continue; }
+
+            if((long)(now - ready[s]) >= 0){ next = s; break; }
+            if(next == MUX_SOCKETS || (long)(ready[s] - ready[next]) < 0){ next = s; }
+        }
+        if(next == MUX_SOCKETS){ break; } // All done
+
+        while((long)(Mux.now() - ready[next]) < 0){} // Nothing else to measure meanwhile
+
+        Mux.select(next + 1);
+
+        Result DUT;
+        Mux.measure(DUT);
+        DUT.Socket = next + 1;
+        report(request, DUT);
+
+        Mux.select(0); // Deselected, the bleed resistors of the socket are switched in
+        ready[next] = Mux.now() + discharge_time(DUT);
+        pending[next] --;
+        last = next;
+        done ++;
+    }
+
+    Mux.select(0);
+    return done;
+}
+
+#undef MUX_CPP
@@ -0,0 +1,38 @@
+#define PROFILE_CPP
+
+#include "common.h"
+#include "config.h"
+#include "functions.h"
+
+/*
+ * Measurement profiles. The sample counts and settling times of the routines are taken from attr::Profile, which
+ * holds one of the rows of PROFILE_TABLE (see config.h):
+ *
+ *  fast        Sorting runs, a fifth of the readings and the shortest settling
+ *  balanced    The usual values
+ *  precise     Characterisation, the most readings the accumulators take
+ *
+ * DEFAULT_PROFILE is selected at boot, then the profile command or a long press of the button (the next one in
+ * turn). Every result carries the profile it was taken with.
+ */
+
+static const Measure_Profile Profiles[PROFILE_COUNT] PROGMEM = PROFILE_TABLE;
+
+// Makes the profile "id" (PROFILE_ defines) the one in use. Returns 1 if there is no such profile.
+bool Profile_Select(byte id)
+{
+    if(id < 1 || id > PROFILE_COUNT){ return 1; }
+
+    memcpy_P(&attr::Profile, &Profiles[id - 1], sizeof(Measure_Profile));
+    return 0;
+}
+
+// Selects the profile after the one in use, back to the first after the last. Returns its ID.
+byte Profile_Next()
+{
+    byte id = (attr::Profile.Id >= PROFILE_COUNT) ? 1 : attr::Profile.Id + 1;
+    Profile_Select(id);
+    return id;
+}
+
+#undef PROFILE_CPP
@@ -0,0 +1,275 @@
+#define PROTOCOL_CPP
+
+#include "common.h"
+#include "config.h"
+#include "functions.h"
+
+/*
+ * Serial link and binary result protocol.
+ *
+ * The Arduino HardwareSerial driver is not used: at 9600 baud its 64 byte buffer fills up after a
+ * couple of lines and every print blocks until the UART catches up. Instead we drive USART0 ourselves
+ * through a larger ring buffer, emptied byte by byte by the "Data Register Empty" interrupt, at LINK_BAUD
+ * (see config.h). Printing only copies bytes into the buffer, so the measurement goes on while the
+ * previous result is still being transmitted.
+ *
+ * Received bytes are stored by the "Receive Complete" interrupt in a second ring buffer, so commands
+ * (see command.cpp) keep arriving while a measurement is running.
+ *
+ * NOTE: Nothing in the project may reference "Serial", otherwise the core's USART0 interrupts
+ * are linked in as well and clash with ours.
+ *
+ * In BINARY_MODE each result is sent as a single frame (little endian, as stored by the AVR):
+ *
+ *  Byte   Field
+ *  0      Protocol version (RESULT_VERSION)
+ *  1      Sequence number, increases by one each frame
+ *  2      Request ID of the command being answered (0 for button presses)
+ *  3      Device flag (see common.h)
+ *  4      Unit prefix of the first value ('k', 'u', 'n', 'p' or ' ')
+ *  5-7    Probe IDs by role (Collector/Drain/Anode/ProbeA, Base/Gate/Cathode/ProbeB, Emitter/Source)
+ *  8-9    Elapsed measurement time (ms)
+ *  10     Number of values (n)
+ *  11-14  Uncertainty of the first value (float, 0 if not estimated)
+ *  15     Multiplexer socket (0 without multiplexer)
+ *  16     Kind, refining the device flag (KIND_ defines)
+ *  17     Partial, why values are cut short or missing (PARTIAL_ defines, 0 if complete)
+ *  18     Agree, scans agreeing on the identification (robust mode, 0 for a single scan)
+ *  19     Profile the result was taken with (PROFILE_ defines, 0 if unknown)
+ *  20...  n float values
+ *  last 2 CRC-16/CCITT-FALSE of all the above
+ *
+ * The frame is COBS encoded, so it holds no zero bytes, and terminated with a 0x00 delimiter. A host
+ * can resynchronise at any point by waiting for the next zero. See Host/result_decoder.py.
+ */
+
+Serial_Link Link;
+
+static byte tx_buffer[TX_BUFFER_SIZE];
+static volatile byte tx_head = 0; // Next free slot, only written by Link.write()
+static volatile byte tx_tail = 0; // Next byte to transmit, only written by the interrupt
+
+static byte rx_buffer[RX_BUFFER_SIZE];
+static volatile byte rx_head = 0; // Next free slot, only written by the interrupt
+static volatile byte rx_tail = 0; // Next byte to read, only written by Link.read()
+
+// Sends the next byte of the ring buffer, switching the interrupt off once the buffer is empty.
+static void tx_next_byte()
+{
+    if(tx_head == tx_tail)
+    {
+        UCSR0B &= ~(1 << UDRIE0);
+        return;
+    }
+    UDR0 = tx_buffer[tx_tail];
+    tx_tail = (tx_tail + 1) & (TX_BUFFER_SIZE - 1);
+}
+
+ISR(USART0_UDRE_vect)
+{
+    tx_next_byte();
+}
+
+// Stores the received byte, it is dropped if the buffer is full.
+ISR(USART0_RX_vect)
+{
+    byte c = UDR0;
+    byte next = (rx_head + 1) & (RX_BUFFER_SIZE - 1);
+
+    if(next != rx_tail)
+    {
+        rx_buffer[rx_head] = c;
+        rx_head = next;
+    }
+}
+
+void Serial_Link::begin(unsigned long baud)
+{
+    // Double speed mode, the baud rate error is lower at high speeds (see the datasheet tables)
+    UCSR0A = (1 << U2X0);
+    UBRR0  = (F_CPU / 4 / baud - 1) / 2;
+    UCSR0C = (1 << UCSZ01) | (1 << UCSZ00); // 8 data bits, no parity, 1 stop bit
+    UCSR0B = (1 << TXEN0) | (1 << RXEN0) | (1 << RXCIE0);
+}
+
+int Serial_Link::available()
+{
+    return (rx_head - rx_tail) & (RX_BUFFER_SIZE - 1);
+}
+
+int Serial_Link::peek()
+{
+    if(rx_head == rx_tail){ return -1; }
+    return rx_buffer[rx_tail];
+}
+
+int Serial_Link::read()
+{
+    if(rx_head == rx_tail){ return -1; }
+    byte c = rx_buffer[rx_tail];
+    rx_tail = (rx_tail + 1) & (RX_BUFFER_SIZE - 1);
+    return c;
+}
+
+size_t Serial_Link::write(uint8_t c)
+{
+    byte next = (tx_head + 1) & (TX_BUFFER_SIZE - 1);
+
+    while(next == tx_tail) // Buffer full, wait for the interrupt to free a slot
+    {
+        if(!(SREG & (1 << SREG_I)) && (UCSR0A & (1 << UDRE0)))
+        {
+            tx_next_byte(); // Interrupts are disabled, we empty the buffer ourselves
+        }
+    }
+
+    tx_buffer[tx_head] = c;
+    tx_head = next;
+    UCSR0B |= (1 << UDRIE0); // (Re)start the transmission
+
+    return 1;
+}
+
+int Serial_Link::availableForWrite()
+{
+    return (tx_tail - tx_head - 1) & (TX_BUFFER_SIZE - 1);
+}
+
+void Serial_Link::flush()
+{
+    while(tx_head != tx_tail){}         // Wait for the buffer to drain
+    while(!(UCSR0A & (1 << UDRE0))){}   // And for the last byte to leave the data register
+}
+
+// CRC-16/CCITT-FALSE (polynomial 0x1021, initial value 0xFFFF), bitwise to save flash.
+unsigned int crc16(const byte *data, byte length)
+{
+    unsigned int crc = 0xFFFF;
+
+    for(byte i = 0; i < length; i++)
+    {
+        crc ^= (unsigned int)data[i] << 8;
+        for(byte b = 0; b < 8; b++)
+        {
+            if(crc & 0x8000){ crc = (crc << 1) ^ 0x1021; }
+            else            { crc <<= 1; }
+        }
+    }
+    return crc;
+}
+
+/*
+ * Consistent Overhead Byte Stuffing. Every zero is replaced by the distance to the next one, the
+ * first byte holds the distance to the first zero. Writes the encoded frame and its 0x00 delimiter.
+ */
+void cobs_send(const byte *data, byte length)
+{
+    byte code = 1;      // Distance to the next zero
+    byte start = 0;     // First byte of the current block
+
+    for(byte i = 0; i < length; i++)
+    {
+        if(data[i] == 0)
+        {
+            Link.write(code);
+            Link.write(data + start, code - 1);
+            start = i + 1;
+            code = 1;
+        }
+        else
+        {
+            code ++;
+            if(code == 0xFF) // Maximum block length, start a new one
+            {
+                Link.write(code);
+                Link.write(data + start, code - 1);
+                start = i + 1;
+                code = 1;
+            }
+        }
+    }
+    Link.write(code);
+    Link.write(data + start, code - 1);
+    Link.write((byte) 0); // Frame delimiter
+}
+
+// Packs the first "count" values of the result into a frame and queues it for transmission.
+void Send_Frame(byte request, const Result &DUT, byte count)
+{
+    static byte sequence = 0;
+
+    byte frame[RESULT_HEADER + 4*RESULT_MAX_VALUES + 2];
+
+    if(count > RESULT_MAX_VALUES){ count = RESULT_MAX_VALUES; } // Sanity check
+
+    frame[0]  = RESULT_VERSION;
+    frame[1]  = sequence++;
+    frame[2]  = request;
+    frame[3]  = DUT.Flag;
+    frame[4]  = DUT.Power;
+    frame[5]  = DUT.Pins[0];
+    frame[6]  = DUT.Pins[1];
+    frame[7]  = DUT.Pins[2];
+    frame[8]  = DUT.Elapsed & 0xFF;
+    frame[9]  = DUT.Elapsed >> 8;
+    frame[10] = count;
+    memcpy(frame + 11, &DUT.Uncertainty, 4);
+    frame[15] = DUT.Socket;
+    frame[16] = DUT.Kind;
+    frame[17] = DUT.Partial;
+    frame[18] = DUT.Agree;
+    frame[19] = DUT.Profile;
+
+    byte length = RESULT_HEADER;
+    memcpy(frame + length, DUT.Value, 4*count);
+    length += 4*count;
+
+    unsigned int crc = crc16(frame, length);
+    frame[length++] = crc & 0xFF;
+    frame[length++] = crc >> 8;
+
+    cobs_send(frame, length);
+}
+
+// Sends a measurement result, with the values used by its kind of device (see the Result class).
+void Send_Result(byte request, const Result &DUT)
+{
+    byte count = 0;
+
+    switch (DUT.Flag)
+    {
+        case RESISTOR_FLAG:
+            count = 1;
+            break;
+
+        case INDUCTOR_FLAG:
+            count = 3;
+            break;
+        case CAPACITOR_FLAG:
+            count = 4;
+            break;
+
+        case DIODE_AC_FLAG:
+        case DIODE_CA_FLAG:
+            count = 8;
+            break;
+
+        case CURVE_FLAG:
+            count = 5;
+            break;
+
+        case NPN_FLAG:
+        case PNP_FLAG:
+        case RESISTOR_NET_FLAG:
+        case NMOS_ENH_FLAG:
+        case NMOS_DEP_FLAG:
+        case PMOS_ENH_FLAG:
+        case PMOS_DEP_FLAG:
+            count = 4;
+            break;
+    }
+
+    Send_Frame(request, DUT, count);
+}
+
+#undef PROTOCOL_CPP
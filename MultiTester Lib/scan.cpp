@@ -0,0 +1,242 @@
+#define SCAN_CPP
+
+#include "common.h"
+#include "config.h"
+#include "functions.h"
+
+#if PROBE_COUNT > SCAN_MAX_PROBES
+    #error "The scan signatures hold 2 states per probe in 16 bits, see SCAN_MAX_PROBES"
+#endif
+
+/*
+ * Drive state scan of the probes, the first step of every identification.
+ *
+ * Each probe is pulled HIGH or LOW through a resistor while all of them are read back. Rather than every
+ * combination (2^N states, and a full pass per probe as we used to) we visit 2N states, each differing from the
+ * previous one by a single pin, so the circuit only has to settle from a small step:
+ *
+ *  State   0      1        2      3        ...  2N-2       2N-1
+ *  HIGH    p0     p0 p1    p1     p1 p2    ...  p(N-1)     p(N-1) p0
+ *
+ * With three probes these are all the six useful combinations, in the order 100 110 010 011 001 101 (probe 1
+ * first), so nothing is lost for the three terminal classifier in identify.cpp.
+ *
+ * All probes are read in every state, so the scan takes 2N settling delays and 2N^2 conversions. The readings
+ * of a probe are stored as a bitset (bit s for state s) in its signature.
+ *
+ * The states form a cycle (the last one also differs from the first by a single pin), so the scan may start
+ * anywhere on it and go either way with the same small steps. Scan_Vote uses this to repeat the scan in random
+ * orders, so a probe losing contact for a moment spoils one scan rather than the same states every time.
+ */
+
+// Probes driven HIGH in the given state of an "n" probe scan (bit p for Probes[p]).
+byte Scan_State(byte state, byte n)
+{
+    byte p = state >> 1;
+    byte mask = 1 << p;
+
+    if(state & 1){ mask |= 1 << ((p + 1) % n); }
+
+    return mask;
+}
+
+// Reading of probe p when the probes of "mask" are driven HIGH, 0 if the scan did not visit that state.
+bool Scan::reads(byte p, byte mask) const
+{
+    for(byte s = 0; s < 2*Count; s++)
+    {
+        if(Scan_State(s, Count) == mask){ return (Signature[p] >> s) & 1; }
+    }
+    return 0;
+}
+
+// Bit s set for the states where some probe reads other than it is driven to (unconnected probes read themselves).
+unsigned int Scan::changes() const
+{
+    unsigned int change = 0;
+
+    for(byte s = 0; s < 2*Count; s++)
+    {
+        byte mask = Scan_State(s, Count);
+        for(byte p = 0; p < Count; p++)
+        {
+            if(((Signature[p] >> s) & 1) != ((mask >> p) & 1)){ change |= 1u << s; }
+        }
+    }
+    return change;
+}
+
+/*
+ * Pulls every probe to GND through its Rl and waits for the voltages to vanish, within the time budget (see
+ * wait_discharge, three probes at a time). Returns 1 on timeout, the result being marked PARTIAL_TIMEOUT.
+ */
+static bool discharge(byte n)
+{
+    for(byte p = 0; p < n; p++)
+    {
+        pinMode(Probes[p]->ID, INPUT);
+        pinMode(Probes[p]->Rl, OUTPUT);
+        digitalWrite(Probes[p]->Rl, LOW);
+    }
+
+    for(byte p = 0; p < n; p += 3)
+    {
+        byte q = min(p + 1, n - 1);
+        byte r = min(p + 2, n - 1);
+        if(wait_discharge(Probes[p]->ID, Probes[q]->ID, Probes[r]->ID)){ return 1; }
+    }
+    return 0;
+}
+
+/*
+ * Network: driving probe a alone, probe b only reads HIGH if current flows from a to b. Both ways round for
+ * resistors, inductors and shorts, a to b only for a diode with its anode on a.
+ */
+static void scan_links(Scan &S)
+{
+    for(byte a = 0; a < S.Count; a++)
+    {
+        S.Link[a] = 0;
+        for(byte b = 0; b < S.Count; b++)
+        {
+            if(b != a && ((S.Signature[b] >> (2*a)) & 1)){ S.Link[a] |= 1 << b; }
+        }
+    }
+}
+
+// Probes back to Hi-Z after a discharge.
+static void release(byte n)
+{
+    for(byte p = 0; p < n; p++){ pinMode(Probes[p]->Rl, INPUT); }
+}
+
+// The drive states of a scan (see Probe_Scan), on discharged probes. Leaves them grounded through their Rl.
+static void scan_pass(Scan &S, byte n, bool Use_Rh, byte start, bool reverse)
+{
+    byte R[PROBE_COUNT]; // Resistors driving each probe
+
+    S.Count = n;
+    for(byte p = 0; p < n; p++)
+    {
+        pinMode(Probes[p]->Rl, INPUT);
+        R[p] = Use_Rh ? Probes[p]->Rh : Probes[p]->Rl;
+        pinMode(R[p], OUTPUT);
+        digitalWrite(R[p], LOW);
+        S.Signature[p] = 0;
+    }
+
+    byte previous = 0;
+    for(byte k = 0; k < 2*n; k++)
+    {
+        byte s = (reverse ? start + 2*n - k : start + k) % (2*n);
+        byte mask = Scan_State(s, n);
+        for(byte p = 0; p < n; p++)
+        {
+            if((mask ^ previous) & (1 << p)){ digitalWrite(R[p], (mask >> p) & 1); } // Only the toggled pin changes
+        }
+        previous = mask;
+        delay(attr::Profile.Settle_ms);
+
+        for(byte p = 0; p < n; p++)
+        {
+            if(Use_Rh){ analogRead(Probes[p]->ID); } // First measures have been observed to be unreliable with high impedances
+            /*
+            * NOTE:
+            * The repeated measures of analogRead to discard the first measurements are inefficient,
+            * but it  is the only method that has been observed to work. Our suspicion is that we are limited by the
+            * charging of the Sample and Hold capacitor of the ADC, which is not though to work under High Impedance frameworks.
+            * The only possible way to avoid these effects is to allow it to charge properly by dismissing the first readings.
+            * Possibly, only the first two readings at the start of each step need to be discarded, but given the time taken is
+            * negligible for the user, we have chosen what we think is a better option in terms of reliability, whicle we sacrifice
+            * some time and efficiency.
+            * 
+            * Any new solutions that would make the measurement scheme cleaner will be welcome.
+            */
+
+            if(analogRead(Probes[p]->ID) > 20){ S.Signature[p] |= 1u << s; } // 1 = HIGH, 0 = LOW
+        }
+    }
+
+    scan_links(S);
+
+    for(byte p = 0; p < n; p++)
+    {
+        digitalWrite(R[p], LOW);
+        pinMode(R[p], INPUT);
+        pinMode(Probes[p]->Rl, OUTPUT); // Rl is left LOW
+    }
+}
+
+/*
+ * Scans the first "n" probes of the table (PROBE_COUNT at most, see config.h) through their Rl, or their Rh for
+ * high impedance parts, starting on state "start" of the cycle and going backwards if "reverse". Fills in the
+ * signatures and the network between the probes. Returns 1 on a discharge timeout.
+ */
+bool Probe_Scan(Scan &S, byte n, bool Use_Rh, byte start, bool reverse)
+{
+    S.Count = n;
+    if(discharge(n)){ return 1; }
+
+    scan_pass(S, n, Use_Rh, start, reverse);
+
+    bool timeout = discharge(n);
+    release(n);
+    return timeout;
+}
+
+/*
+ * Consensus of repeated scans, for probes with an unreliable contact. The scan is repeated in random orders (see
+ * above) until "votes" of them agree on the signatures, CONSENSUS_MAX_SCANS at most: a good contact costs "votes"
+ * scans. S gets the winning scan, or the most repeated one if none got there (the first of them on a tie), and
+ * "agree" how many scans gave it. Returns 1 on a discharge timeout.
+ *
+ * The probes are discharged once before the votes and once after. In between, a repeat only checks that they
+ * are still empty (at once unless the part holds charge), and the votes stop where the budget does not leave
+ * room for another scan or the check times out.
+ */
+bool Scan_Vote(Scan &S, byte n, bool Use_Rh, byte votes, byte *agree)
+{
+    unsigned int seen[CONSENSUS_MAX_SCANS][PROBE_COUNT]; // Distinct signatures so far
+    byte tally[CONSENSUS_MAX_SCANS];
+    byte distinct = 0;
+    byte best = 0;
+
+    if(votes > CONSENSUS_MAX_SCANS){ votes = CONSENSUS_MAX_SCANS; } // Sanity check
+    if(n > PROBE_COUNT){ n = PROBE_COUNT; }
+
+    const unsigned long scan_ms = 2UL * n * attr::Profile.Settle_ms + 1;
+    if(discharge(n)){ return 1; }
+
+    for(byte i = 0; i < CONSENSUS_MAX_SCANS; i++)
+    {
+        if(i && Budget_ms(scan_ms) < scan_ms){ Budget_Partial(PARTIAL_SAMPLES); break; }
+        if(i && discharge(n)){ break; } // Budgeted, already marked PARTIAL_TIMEOUT
+
+        scan_pass(S, n, Use_Rh, random(2*n), random(2));
+
+        byte c = 0;
+        while(c < distinct && memcmp(seen[c], S.Signature, n * sizeof(unsigned int))){ c++; }
+        if(c == distinct)
+        {
+            memcpy(seen[c], S.Signature, n * sizeof(unsigned int));
+            tally[c] = 0;
+            distinct ++;
+        }
+        tally[c] ++;
+
+        if(tally[c] > tally[best]){ best = c; }
+        if(tally[best] >= votes){ break; }
+    }
+
+    bool timeout = discharge(n);
+    release(n);
+    if(timeout){ return 1; }
+
+    S.Count = n;
+    memcpy(S.Signature, seen[best], n * sizeof(unsigned int));
+    scan_links(S);
+    *agree = tally[best];
+    return 0;
+}
+
+#undef SCAN_CPP
@@ -0,0 +1,89 @@
+#define TEMP_CPP
+
+#include "common.h"
+#include "config.h"
+#include "functions.h"
+
+/*
+ * Die temperature, from the internal sensor of the ATmega328PB (ADC channel 8, against the 1.1 V reference).
+ *
+ * It is kept in attr::Thermal with the scales it gives the calibrated values: the shunts (through Probe::Rl_val() ...), the internal pin resistances (INTERNAL_R_LOW/HIGH)
+ * and the bandgap (BANDGAP_V), each with its own coefficient in config.h. The semiconductor results are then
+ * brought back to 25 C with the Thermal_ helpers below, so parts measured over a shift compare.
+ *
+ * Sampling switches the ADC reference twice and waits TEMP_SETTLE_MS each way, for a value that drifts over seconds,
+ * so measures only resample it through Temperature_Update once TEMP_INTERVAL_MS have passed, and not at all while
+ * held (the repeat command holds it over its runs).
+ */
+
+#define TEMP_CHANNEL 0b1000 // MUX3..0 of the sensor
+
+static unsigned long Sampled_At = 0;
+static bool Sampled = 0;
+static bool Held = 0;
+
+// Samples the die temperature and updates attr::Thermal. Returns the temperature in C.
+float Temperature_Sample()
+{
+    ADMUX = (1 << REFS1) | (1 << REFS0) | TEMP_CHANNEL; // Internal 1.1 V reference
+    ADCSRA |= (1 << ADEN);
+    delay(TEMP_SETTLE_MS); // AREF falling to the reference
+
+    unsigned int sum = 0;
+    for(byte i = 0; i <= TEMP_SAMPLES; i++)
+    {
+        ADCSRA |= (1 << ADSC);
+        while(ADCSRA & (1 << ADSC)){}
+        if(i){ sum += ADC; } // The first conversion after switching the reference is discarded
+    }
+
+    ADMUX = (1 << REFS0); // Back to AVcc, where analogRead() expects it
+    delay(TEMP_SETTLE_MS);
+
+    float T = ((float) sum / TEMP_SAMPLES - TEMP_25C_LSB) / TEMP_LSB_PER_C + 25;
+    float dT = T - TEMP_CAL_C;
+
+    attr::Thermal.Celsius = T;
+    attr::Thermal.Shunt   = 1 + SHUNT_TC_PPM * 1e-6 * dT;
+    attr::Thermal.Pin_R   = 1 + PIN_R_TC_PPM * 1e-6 * dT;
+    attr::Thermal.Bandgap = 1 + BANDGAP_TC_PPM * 1e-6 * dT;
+
+    Sampled = 1;
+    Sampled_At = millis();
+    return T;
+}
+
+// Resamples the die temperature if the last sample is older than TEMP_INTERVAL_MS and it is not held. Returns it in C.
+float Temperature_Update()
+{
+    if(Sampled && (Held || millis() - Sampled_At < TEMP_INTERVAL_MS)){ return attr::Thermal.Celsius; }
+    return Temperature_Sample();
+}
+
+// Keeps the current sample, whatever its age, until released.
+void Temperature_Hold(bool hold)
+{
+    Held = hold;
+}
+
+// A voltage with a linear coefficient (mV/C), as it would read at 25 C.
+float Thermal_25C_mV(float V, float tc_mV)
+{
+    return V - tc_mV * (attr::Thermal.Celsius - 25);
+}
+
+// A quantity going as T^exponent (absolute temperatures), as it would be at 25 C.
+float Thermal_25C_Pow(float x, float exponent)
+{
+    return x * pow(298.15 / (attr::Thermal.Celsius + 273.15), exponent);
+}
+
+// Saturation current of a junction (ideality n), as it would be at 25 C: Is ~ T^(XTI/n) exp(-Eg / (n k T)).
+float Thermal_25C_Is(float Is, float n)
+{
+    float T = attr::Thermal.Celsius + 273.15;
+
+    return Thermal_25C_Pow(Is, DIODE_XTI / n) * exp(DIODE_EG / (n * 8.617333e-5) * (1 / T - 1 / 298.15));
+}
+
+#undef TEMP_CPP